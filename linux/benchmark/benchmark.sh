@@ -0,0 +1,175 @@
+#!/bin/sh
+# benchmark.sh
+#
+# Copyright (C) 2026 Intelight Inc.
+#
+# Performance benchmark of the loopback tests without ATC hardware. ethtest
+# runs over a veth pair inside a private network namespace, sertest and
+# mctltest over pty pairs provided by benchrun. Each workload is repeated
+# and the median throughput, latency percentiles and CPU time are compared
+# against a baseline file.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+
+dir=$(cd "$(dirname "$0")" && pwd)
+benchrun=$dir/benchrun
+ethtest=$dir/../ethtest/ethtest
+sertest=$dir/../sertest/sertest
+mctltest=$dir/../mctltest/mctltest
+ns=atcbench$$
+runs=5
+threshold=10
+update=0
+
+usage() {
+	printf "Usage: benchmark.sh [-r runs] [-t threshold_pct] [-u]" >&2
+	printf " baseline_file\n\n" >&2
+	printf "  -u  write the results to baseline_file\n" >&2
+	exit 1
+}
+
+while getopts "r:t:u" opt; do
+	case $opt in
+	r) runs=$OPTARG ;;
+	t) threshold=$OPTARG ;;
+	u) update=1 ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 1 ] || usage
+baseline=$1
+
+for tool in "$benchrun" "$ethtest" "$sertest" "$mctltest"; do
+	if [ ! -x "$tool" ]; then
+		printf "%s not built\n" "$tool"
+		exit 1
+	fi
+done
+
+tmp=$(mktemp -d)
+cleanup() {
+	ip netns del $ns 2>/dev/null
+	rm -rf "$tmp"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+printf "Benchmark (%d runs per workload, %d%% threshold)\n" $runs $threshold
+# No IPv6 in the namespace, so no autoconfiguration frames reach the
+# ETH_P_ALL receive socket of ethtest
+if ! ip netns add $ns ||
+   ! ip netns exec $ns sysctl -qw net.ipv6.conf.all.disable_ipv6=1 \
+	net.ipv6.conf.default.disable_ipv6=1 ||
+   ! ip -n $ns link add bench0 type veth peer name bench1 ||
+   ! ip -n $ns link set bench0 up || ! ip -n $ns link set bench1 up; then
+	printf "unable to create veth fixture (root required)\n"
+	exit 1
+fi
+
+failed=0
+: > "$tmp/results"
+
+# bench name benchrun_args... : median of $runs runs as "name metric value"
+bench() {
+	name=$1
+	shift
+	: > "$tmp/runs"
+	i=0
+	while [ $i -lt $runs ]; do
+		if ! "$benchrun" "$@" > "$tmp/out" 2>&1; then
+			printf "%s: failed\n" $name
+			cat "$tmp/out"
+			failed=1
+			return
+		fi
+		awk 'BEGIN { kbps = p50 = p99 = cpu = "-" }
+		     /approximate .* kbps/ { kbps = $(NF - 1) }
+		     /latency:/ {
+			for (i = 1; i < NF; i++) {
+				if ($i == "p50") p50 = $(i + 1)
+				if ($i == "p99") p99 = $(i + 1)
+			}
+		     }
+		     /^benchrun:/ { cpu = $6 + $9 }
+		     END { print kbps, p50, p99, cpu }' "$tmp/out" >> "$tmp/runs"
+		i=$((i + 1))
+	done
+	awk -v name=$name '
+		{ for (c = 1; c <= NF; c++) v[c, NR] = $c; cols = NF }
+		END {
+			split("kbps p50_us p99_us cpu_s", metric)
+			for (c = 1; c <= cols; c++) {
+				for (i = 1; i <= NR; i++) s[i] = v[c, i]
+				for (i = 2; i <= NR; i++)
+					for (j = i; j > 1 && s[j - 1] > s[j]; j--) {
+						t = s[j]; s[j] = s[j - 1]; s[j - 1] = t
+					}
+				printf "%s %s %s\n", name, metric[c], s[int((NR + 1) / 2)]
+			}
+		}' "$tmp/runs" | awk '$3 != "-"' >> "$tmp/results"
+	printf "%s: done\n" $name
+}
+
+bench eth-64 ip netns exec $ns "$ethtest" bench0:bench1 200000 64
+bench eth-1500 ip netns exec $ns "$ethtest" bench0:bench1 100000 1500
+bench eth-uring-1500 ip netns exec $ns "$ethtest" -U bench0:bench1 100000 1500
+# Probe latency with the bulk stream running (the last latency line)
+bench eth-load-1024 ip netns exec $ns "$ethtest" -l bench0:bench1 1000 1024
+bench eth-rt ip netns exec $ns "$ethtest" -R 0 bench0:bench1 1000
+bench eth-flap ip netns exec $ns "$ethtest" -F 20 bench0:bench1
+bench ser-echo-64 -l "$sertest" -l PTY1 115200 20000 64
+bench ser-pair-1024 -x "$sertest" -l PTY1:PTY2 115200 10000 1024
+bench ser-uring-1024 -x "$sertest" -l -U PTY1:PTY2 115200 10000 1024
+
+# Unix98 ptys have no modem control lines; mctltest only runs where the
+# pty driver emulates them
+if "$benchrun" -x "$mctltest" PTY1:PTY2 > "$tmp/out" 2>&1; then
+	bench mctl-pair -x "$mctltest" PTY1:PTY2
+else
+	printf "mctl-pair: skipped, %s\n" "$(head -n 1 "$tmp/out")"
+fi
+
+if [ $update -eq 1 ] || [ ! -f "$baseline" ]; then
+	cp "$tmp/results" "$baseline"
+	printf "baseline written to %s\n" "$baseline"
+fi
+
+# Throughput may not drop, latency and CPU time may not rise, by more than
+# the threshold
+if ! awk -v threshold=$threshold '
+	NR == FNR { base[$1 " " $2] = $3; next }
+	FNR == 1 {
+		printf "%-16s %-8s %12s %12s %8s\n", "workload", "metric",
+		       "baseline", "current", "change"
+	}
+	{
+		key = $1 " " $2
+		if (!(key in base) || base[key] == 0) {
+			printf "%-16s %-8s %12s %12s\n", $1, $2, "-", $3
+			next
+		}
+		change = ($3 - base[key]) * 100 / base[key]
+		worse = ($2 == "kbps") ? -change : change
+		flag = ""
+		if (worse > threshold) {
+			flag = " REGRESSION"
+			regressed = 1
+		}
+		printf "%-16s %-8s %12s %12s %+7.1f%%%s\n", $1, $2,
+		       base[key], $3, change, flag
+	}
+	END { exit regressed }' "$baseline" "$tmp/results"; then
+	failed=1
+fi
+
+if [ $failed -ne 0 ]; then
+	printf "Failed\n"
+	exit 1
+fi
+printf "Passed\n"
+exit 0
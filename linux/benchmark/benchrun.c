@@ -0,0 +1,199 @@
+/*
+ * benchrun.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Benchmark fixture runner. Runs a test command, optionally against pseudo
+ * terminals standing in for serial ports, and reports its wall clock and
+ * CPU time once it exits.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BUF_SIZE	4096
+
+struct pty {
+	int master;
+	int slave;		/* kept open so the master never sees a hangup */
+	char name[64];
+};
+
+static int sigchld_pipe[2];
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "benchrun version 1.0\n"
+		"\n"
+		"Usage: benchrun [-l | -x] command [args...]\n"
+		"\n"
+		"  -l  replace PTY1 in args with a pty that echoes its input\n"
+		"  -x  replace PTY1 and PTY2 with a pty pair wired like a\n"
+		"      null-modem cable\n");
+	exit(1);
+}
+
+static void pty_open(struct pty *pty)
+{
+	struct termios tio;
+
+	if ((pty->master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 ||
+	    grantpt(pty->master) || unlockpt(pty->master) ||
+	    ptsname_r(pty->master, pty->name, sizeof(pty->name))) {
+		fprintf(stderr, "Unable to create pty: %s\n", strerror(errno));
+		exit(1);
+	}
+	if ((pty->slave = open(pty->name, O_RDWR | O_NOCTTY)) < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", pty->name,
+			strerror(errno));
+		exit(1);
+	}
+	/* Raw until the test configures the port itself */
+	tcgetattr(pty->slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(pty->slave, TCSANOW, &tio);
+	fcntl(pty->master, F_SETFL, O_NONBLOCK);
+}
+
+/* Move whatever is waiting on from to the far end of the wire, to */
+static void relay(int from, int to)
+{
+	unsigned char buf[BUF_SIZE];
+	ssize_t len, done, res;
+
+	if ((len = read(from, buf, sizeof(buf))) <= 0)
+		return;
+	for (done = 0; done < len; done += res) {
+		if ((res = write(to, buf + done, len - done)) < 0) {
+			if (errno != EAGAIN && errno != EINTR)
+				return;
+			res = 0;
+			poll(&(struct pollfd){ .fd = to, .events = POLLOUT },
+			     1, 10);
+		}
+	}
+}
+
+static void sigchld(int sig)
+{
+	(void)sig;
+	if (write(sigchld_pipe[1], "", 1) < 0)
+		return;
+}
+
+static char *subst(char *arg, struct pty *pty, int npty)
+{
+	if (npty >= 1 && !strcmp(arg, "PTY1"))
+		return pty[0].name;
+	if (npty >= 2 && !strcmp(arg, "PTY2"))
+		return pty[1].name;
+	if (npty >= 2 && !strcmp(arg, "PTY1:PTY2")) {
+		if (asprintf(&arg, "%s:%s", pty[0].name, pty[1].name) < 0)
+			exit(1);
+	}
+	return arg;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pty pty[2];
+	struct pollfd pfd[3];
+	struct timespec start, end;
+	struct rusage ru;
+	int npty = 0, status, opt, i;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "+lx")) != -1) {
+		switch (opt) {
+		case 'l':
+			npty = 1;
+			break;
+		case 'x':
+			npty = 2;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 1)
+		usage();
+
+	for (i = 0; i < npty; i++)
+		pty_open(&pty[i]);
+	for (i = 0; i < argc; i++)
+		argv[i] = subst(argv[i], pty, npty);
+
+	if (pipe2(sigchld_pipe, O_CLOEXEC | O_NONBLOCK)) {
+		fprintf(stderr, "pipe() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+	signal(SIGCHLD, sigchld);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if ((pid = fork()) < 0) {
+		fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+	if (pid == 0) {
+		for (i = 0; i < npty; i++) {
+			close(pty[i].master);
+			close(pty[i].slave);
+		}
+		execvp(argv[0], argv);
+		fprintf(stderr, "Unable to run %s: %s\n", argv[0],
+			strerror(errno));
+		_exit(127);
+	}
+
+	pfd[0].fd = sigchld_pipe[0];
+	pfd[0].events = POLLIN;
+	for (i = 0; i < npty; i++) {
+		pfd[i + 1].fd = pty[i].master;
+		pfd[i + 1].events = POLLIN;
+	}
+	while (waitpid(pid, &status, WNOHANG) == 0) {
+		if (poll(pfd, npty + 1, -1) < 0 && errno != EINTR) {
+			fprintf(stderr, "poll() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+		/* Loopback echoes on the same pty, a pair crosses over */
+		if (npty == 1 && (pfd[1].revents & POLLIN))
+			relay(pty[0].master, pty[0].master);
+		if (npty == 2 && (pfd[1].revents & POLLIN))
+			relay(pty[0].master, pty[1].master);
+		if (npty == 2 && (pfd[2].revents & POLLIN))
+			relay(pty[1].master, pty[0].master);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	getrusage(RUSAGE_CHILDREN, &ru);
+
+	fflush(stdout);
+	printf("benchrun: wall %.3f s user %.3f s sys %.3f s\n",
+	       (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9,
+	       ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+	if (WIFSIGNALED(status))
+		exit(128 + WTERMSIG(status));
+	exit(WEXITSTATUS(status));
+}
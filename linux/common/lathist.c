@@ -0,0 +1,99 @@
+/*
+ * lathist.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Log-linear latency histogram for per-packet latency percentiles.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lathist.h"
+
+#define SUB	(1 << LATHIST_SUB_BITS)
+
+static unsigned int bucket_index(uint64_t ns)
+{
+	unsigned int e;
+
+	if (ns < SUB)
+		return ns;
+	e = 63 - __builtin_clzll(ns);
+	return ((e - LATHIST_SUB_BITS + 1) << LATHIST_SUB_BITS) +
+	       ((ns >> (e - LATHIST_SUB_BITS)) & (SUB - 1));
+}
+
+/* Largest value that falls into bucket i */
+static uint64_t bucket_limit(unsigned int i)
+{
+	unsigned int e;
+
+	if (i < SUB)
+		return i;
+	e = (i >> LATHIST_SUB_BITS) + LATHIST_SUB_BITS - 1;
+	return ((uint64_t)(SUB + (i & (SUB - 1))) << (e - LATHIST_SUB_BITS)) +
+	       ((1ULL << (e - LATHIST_SUB_BITS)) - 1);
+}
+
+void lathist_init(struct lathist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min_ns = UINT64_MAX;
+}
+
+void lathist_add(struct lathist *h, uint64_t ns)
+{
+	h->bucket[bucket_index(ns)]++;
+	h->count++;
+	h->sum_ns += ns;
+	if (ns < h->min_ns)
+		h->min_ns = ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+uint64_t lathist_percentile(const struct lathist *h, double p)
+{
+	uint64_t rank, seen = 0, limit;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+	rank = (uint64_t)(p / 100 * h->count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < LATHIST_BUCKETS; i++) {
+		seen += h->bucket[i];
+		if (seen >= rank)
+			break;
+	}
+	/* Report the bucket limit, but never beyond what was measured */
+	limit = bucket_limit(i < LATHIST_BUCKETS ? i : LATHIST_BUCKETS - 1);
+	if (limit > h->max_ns)
+		limit = h->max_ns;
+	if (limit < h->min_ns)
+		limit = h->min_ns;
+	return limit;
+}
+
+void lathist_report(const struct lathist *h, const char *label)
+{
+	if (!h->count) {
+		printf("%s latency: no samples\n", label);
+		return;
+	}
+	printf("%s latency: min %.1f avg %.1f p50 %.1f p90 %.1f p99 %.1f "
+	       "p99.9 %.1f max %.1f us (%llu samples)\n", label,
+	       h->min_ns / 1e3, (double)h->sum_ns / h->count / 1e3,
+	       lathist_percentile(h, 50) / 1e3,
+	       lathist_percentile(h, 90) / 1e3,
+	       lathist_percentile(h, 99) / 1e3,
+	       lathist_percentile(h, 99.9) / 1e3, h->max_ns / 1e3,
+	       (unsigned long long)h->count);
+}
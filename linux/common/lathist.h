@@ -0,0 +1,41 @@
+/*
+ * lathist.h
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Log-linear latency histogram for per-packet latency percentiles.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef LATHIST_H
+#define LATHIST_H
+
+#include <stdint.h>
+
+/*
+ * Every power of two is split into 8 linear buckets, so any recorded
+ * value is resolved to within 12.5% from nanoseconds up to hours.
+ */
+#define LATHIST_SUB_BITS	3
+#define LATHIST_BUCKETS		((64 - LATHIST_SUB_BITS + 1) << LATHIST_SUB_BITS)
+
+struct lathist {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t bucket[LATHIST_BUCKETS];
+};
+
+void lathist_init(struct lathist *h);
+void lathist_add(struct lathist *h, uint64_t ns);
+/* Value at or below which p percent of the samples fall, in ns */
+uint64_t lathist_percentile(const struct lathist *h, double p);
+/* Print one "<label> latency: min ... max ... us" line to stdout */
+void lathist_report(const struct lathist *h, const char *label);
+
+#endif /* LATHIST_H */
@@ -0,0 +1,115 @@
+/*
+ * livestats.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Live statistics block shared through a memory-mapped file under
+ * /dev/shm, so long soak runs can be watched with statview while they run.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "livestats.h"
+
+#define LIVESTATS_READ_TRIES	1000
+
+static struct livestats *livestats_block = NULL;
+static char livestats_path[128];
+
+static void livestats_atexit(void)
+{
+	livestats_close(livestats_block);
+}
+
+struct livestats *livestats_open(const char *tool, const char *desc)
+{
+	struct livestats *ls;
+	struct timespec ts;
+	int fd;
+
+	snprintf(livestats_path, sizeof(livestats_path), "%s/%s%s.%d",
+		 LIVESTATS_DIR, LIVESTATS_PREFIX, tool, (int)getpid());
+	/*
+	 * The path is predictable and we usually run as root: drop a stale
+	 * block left by an earlier process with this pid, then create the
+	 * file exclusively so a planted file or symlink is never followed
+	 */
+	unlink(livestats_path);
+	if ((fd = open(livestats_path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW,
+		       0644)) < 0 ||
+	    ftruncate(fd, sizeof(*ls)) < 0) {
+		fprintf(stderr, "Unable to create %s: %s\n", livestats_path,
+			strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			unlink(livestats_path);
+		}
+		return NULL;
+	}
+	ls = mmap(NULL, sizeof(*ls), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ls == MAP_FAILED) {
+		fprintf(stderr, "Unable to map %s: %s\n", livestats_path,
+			strerror(errno));
+		unlink(livestats_path);
+		return NULL;
+	}
+
+	strncpy(ls->tool, tool, sizeof(ls->tool) - 1);
+	strncpy(ls->desc, desc, sizeof(ls->desc) - 1);
+	ls->pid = getpid();
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ls->start_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	ls->version = LIVESTATS_VERSION;
+	/* Readers ignore the block until the magic is visible */
+	__atomic_store_n(&ls->magic, LIVESTATS_MAGIC, __ATOMIC_RELEASE);
+
+	livestats_block = ls;
+	atexit(livestats_atexit);
+	printf("live statistics in %s\n", livestats_path);
+	return ls;
+}
+
+void livestats_close(struct livestats *ls)
+{
+	if (!ls || ls != livestats_block)
+		return;
+	__atomic_store_n(&ls->done, 1, __ATOMIC_RELEASE);
+	/* A running statview keeps its mapping and shows the final state */
+	unlink(livestats_path);
+	munmap(ls, sizeof(*ls));
+	livestats_block = NULL;
+}
+
+int livestats_read(const struct livestats *ls, struct livestats *copy)
+{
+	uint32_t seq;
+	int tries;
+
+	for (tries = 0; tries < LIVESTATS_READ_TRIES; tries++) {
+		seq = __atomic_load_n(&ls->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		memcpy(copy, ls, sizeof(*copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&ls->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	memcpy(copy, ls, sizeof(*copy));
+	return -1;
+}
@@ -0,0 +1,105 @@
+/*
+ * livestats.h
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Live statistics block shared through a memory-mapped file under
+ * /dev/shm, so long soak runs can be watched with statview while they run.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef LIVESTATS_H
+#define LIVESTATS_H
+
+#include <stdint.h>
+
+#define LIVESTATS_DIR		"/dev/shm"
+#define LIVESTATS_PREFIX	"atcstats."
+#define LIVESTATS_MAGIC		0x41544353	/* "ATCS" */
+#define LIVESTATS_VERSION	2
+
+/*
+ * The counters are 64-bit so byte counts and latency sums do not wrap on
+ * soak runs, which 32-bit targets cannot load or store in one access.
+ * They are guarded by a sequence count instead: writers make seq odd,
+ * update the counters and make it even again, readers copy the counters
+ * and retry if seq was odd or moved. Only 32-bit atomics are used, so
+ * nothing falls back to libatomic and statview never takes a lock.
+ */
+struct livestats {
+	uint32_t magic;
+	uint32_t version;
+	char tool[16];
+	char desc[64];
+	int32_t pid;
+	uint32_t done;			/* set when the test has finished */
+	uint32_t seq;			/* odd while the counters change */
+	uint32_t reserved;
+	uint64_t start_ns;		/* CLOCK_REALTIME at start */
+	uint64_t tx_packets;
+	uint64_t tx_bytes;
+	uint64_t rx_packets;
+	uint64_t rx_bytes;
+	uint64_t errors;
+	uint64_t latency_samples;
+	uint64_t latency_sum_ns;
+	uint64_t latency_max_ns;
+};
+
+/* Create /dev/shm/atcstats.<tool>.<pid>; NULL (with a warning) on failure */
+struct livestats *livestats_open(const char *tool, const char *desc);
+/* Mark the block done and remove the file; also run at exit() */
+void livestats_close(struct livestats *ls);
+/*
+ * Consistent copy of the block for a reader in another process; -1 if a
+ * writer stayed inside an update (e.g. it was killed), copy then may be torn
+ */
+int livestats_read(const struct livestats *ls, struct livestats *copy);
+
+/*
+ * Bracket every group of counter updates. Claiming the odd count with a
+ * compare-and-swap also serialises the threads of one test that share a
+ * block; updates must not nest.
+ */
+static inline void livestats_begin(struct livestats *ls)
+{
+	uint32_t seq = __atomic_load_n(&ls->seq, __ATOMIC_RELAXED);
+
+	while ((seq & 1) ||
+	       !__atomic_compare_exchange_n(&ls->seq, &seq, seq + 1, 1,
+					    __ATOMIC_ACQUIRE,
+					    __ATOMIC_RELAXED))
+		seq = __atomic_load_n(&ls->seq, __ATOMIC_RELAXED);
+	/* The odd count is visible before any counter changes */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void livestats_end(struct livestats *ls)
+{
+	__atomic_store_n(&ls->seq, __atomic_load_n(&ls->seq, __ATOMIC_RELAXED) + 1,
+			 __ATOMIC_RELEASE);
+}
+
+static inline void livestats_set(uint64_t *counter, uint64_t value)
+{
+	*counter = value;
+}
+
+static inline void livestats_add(uint64_t *counter, uint64_t n)
+{
+	*counter += n;
+}
+
+static inline void livestats_latency(struct livestats *ls, uint64_t ns)
+{
+	ls->latency_samples++;
+	ls->latency_sum_ns += ns;
+	if (ns > ls->latency_max_ns)
+		ls->latency_max_ns = ns;
+}
+
+#endif /* LIVESTATS_H */
@@ -0,0 +1,154 @@
+/*
+ * perfcnt.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Optional hardware/software performance counters for the loopback tests.
+ * Counters are opened with perf_event_open() for the calling thread only.
+ * Anything the kernel or the PMU refuses (no PMU on the SoC, running under
+ * a hypervisor, perf_event_paranoid too high) is reported as "n/a" instead
+ * of failing the test.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfcnt.h"
+
+static const struct {
+	const char *name;
+	uint32_t type;
+	uint64_t config;
+} perfcnt_events[PERFCNT_NUM] = {
+	[PERFCNT_CYCLES] = { "cycles",
+		PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	[PERFCNT_INSTRUCTIONS] = { "instructions",
+		PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	[PERFCNT_CACHE_MISSES] = { "cache-misses",
+		PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	[PERFCNT_CONTEXT_SWITCHES] = { "context-switches",
+		PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+	[PERFCNT_PAGE_FAULTS] = { "page-faults",
+		PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+struct perfcnt_read {
+	uint64_t value;
+	uint64_t time_enabled;
+	uint64_t time_running;
+};
+
+static int perf_event_open(struct perf_event_attr *attr)
+{
+	return syscall(__NR_perf_event_open, attr, 0, -1, -1, 0);
+}
+
+void perfcnt_open(struct perfcnt *pc)
+{
+	struct perf_event_attr attr;
+	int i;
+
+	for (i = 0; i < PERFCNT_NUM; i++) {
+		pc->value[i] = 0;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perfcnt_events[i].type;
+		attr.config = perfcnt_events[i].config;
+		attr.disabled = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+				   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		pc->fd[i] = perf_event_open(&attr);
+		if (pc->fd[i] < 0 && (errno == EACCES || errno == EPERM)) {
+			/* perf_event_paranoid >= 2: count user space only */
+			attr.exclude_kernel = 1;
+			pc->fd[i] = perf_event_open(&attr);
+		}
+		if (pc->fd[i] < 0)
+			fprintf(stderr, "perf counter %s unavailable: %s\n",
+				perfcnt_events[i].name, strerror(errno));
+	}
+}
+
+void perfcnt_start(struct perfcnt *pc)
+{
+	int i;
+
+	for (i = 0; i < PERFCNT_NUM; i++) {
+		if (pc->fd[i] < 0)
+			continue;
+		ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void perfcnt_stop(struct perfcnt *pc)
+{
+	struct perfcnt_read rd;
+	int i;
+
+	for (i = 0; i < PERFCNT_NUM; i++) {
+		if (pc->fd[i] < 0)
+			continue;
+		ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(pc->fd[i], &rd, sizeof(rd)) != sizeof(rd)) {
+			fprintf(stderr, "perf counter %s read failed\n",
+				perfcnt_events[i].name);
+			close(pc->fd[i]);
+			pc->fd[i] = -1;
+			continue;
+		}
+		/* Scale up if the PMU was multiplexed between events */
+		if (rd.time_running && rd.time_running < rd.time_enabled)
+			rd.value = (uint64_t)((double)rd.value *
+					      rd.time_enabled / rd.time_running);
+		pc->value[i] = rd.value;
+	}
+}
+
+void perfcnt_report(struct perfcnt *pc, unsigned long packets,
+		    unsigned long long bytes)
+{
+	int i;
+
+	printf("%-18s %14s %14s %10s\n", "perf counter", "total",
+	       "per packet", "per byte");
+	for (i = 0; i < PERFCNT_NUM; i++) {
+		if (pc->fd[i] < 0) {
+			printf("%-18s %14s\n", perfcnt_events[i].name, "n/a");
+			continue;
+		}
+		printf("%-18s %14llu %14.2f %10.3f\n", perfcnt_events[i].name,
+		       (unsigned long long)pc->value[i],
+		       packets ? (double)pc->value[i] / packets : 0.0,
+		       bytes ? (double)pc->value[i] / bytes : 0.0);
+	}
+	if (pc->fd[PERFCNT_CYCLES] >= 0 && pc->fd[PERFCNT_INSTRUCTIONS] >= 0 &&
+	    pc->value[PERFCNT_CYCLES])
+		printf("instructions per cycle: %.2f\n",
+		       (double)pc->value[PERFCNT_INSTRUCTIONS] /
+		       pc->value[PERFCNT_CYCLES]);
+}
+
+void perfcnt_close(struct perfcnt *pc)
+{
+	int i;
+
+	for (i = 0; i < PERFCNT_NUM; i++) {
+		if (pc->fd[i] >= 0)
+			close(pc->fd[i]);
+		pc->fd[i] = -1;
+	}
+}
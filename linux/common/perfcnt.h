@@ -0,0 +1,42 @@
+/*
+ * perfcnt.h
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Optional hardware/software performance counters for the loopback tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PERFCNT_H
+#define PERFCNT_H
+
+#include <stdint.h>
+
+enum {
+	PERFCNT_CYCLES,
+	PERFCNT_INSTRUCTIONS,
+	PERFCNT_CACHE_MISSES,
+	PERFCNT_CONTEXT_SWITCHES,
+	PERFCNT_PAGE_FAULTS,
+	PERFCNT_NUM
+};
+
+struct perfcnt {
+	int fd[PERFCNT_NUM];		/* -1 if the counter is unavailable */
+	uint64_t value[PERFCNT_NUM];	/* scaled count after perfcnt_stop() */
+};
+
+/* Open every counter the kernel/PMU allows, leaving the rest at -1 */
+void perfcnt_open(struct perfcnt *pc);
+void perfcnt_start(struct perfcnt *pc);
+void perfcnt_stop(struct perfcnt *pc);
+/* Print totals, per-packet and per-byte figures to stdout */
+void perfcnt_report(struct perfcnt *pc, unsigned long packets,
+		    unsigned long long bytes);
+void perfcnt_close(struct perfcnt *pc);
+
+#endif /* PERFCNT_H */
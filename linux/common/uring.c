@@ -0,0 +1,153 @@
+/*
+ * uring.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Minimal io_uring wrapper for the loopback tests, using the raw system
+ * calls so no liburing is needed in the BSP.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+int uring_init(struct uring *ring, unsigned int entries)
+{
+	struct io_uring_params p;
+	char *sq, *cq;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	if ((ring->fd = io_uring_setup(entries, &p)) < 0)
+		return -1;
+	ring->features = p.features;
+
+	ring->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_sz = p.cq_off.cqes +
+			   p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	ring->cq_ring = mmap(NULL, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_CQ_RING);
+	ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+	    ring->sqes == MAP_FAILED) {
+		int err = errno;
+
+		uring_exit(ring);
+		errno = err;
+		return -1;
+	}
+
+	sq = ring->sq_ring;
+	ring->sq_head = (unsigned int *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + p.sq_off.array);
+	ring->sqe_tail = *ring->sq_tail;
+
+	cq = ring->cq_ring;
+	ring->cq_head = (unsigned int *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	return 0;
+}
+
+void uring_exit(struct uring *ring)
+{
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_sz);
+	if (ring->cq_ring && ring->cq_ring != MAP_FAILED)
+		munmap(ring->cq_ring, ring->cq_ring_sz);
+	if (ring->sq_ring && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_sz);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	ring->fd = -1;
+}
+
+int uring_register_buffers(struct uring *ring, const struct iovec *iov,
+			   unsigned int nr)
+{
+	return syscall(__NR_io_uring_register, ring->fd,
+		       IORING_REGISTER_BUFFERS, iov, nr);
+}
+
+struct io_uring_sqe *uring_get_sqe(struct uring *ring)
+{
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	unsigned int idx;
+
+	if (ring->sqe_tail - head > *ring->sq_mask)
+		return NULL;
+	idx = ring->sqe_tail++ & *ring->sq_mask;
+	ring->sq_array[idx] = idx;
+	memset(&ring->sqes[idx], 0, sizeof(ring->sqes[idx]));
+	return &ring->sqes[idx];
+}
+
+unsigned int uring_sq_space(struct uring *ring)
+{
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+	return *ring->sq_mask + 1 - (ring->sqe_tail - head);
+}
+
+int uring_submit(struct uring *ring, unsigned int wait_nr)
+{
+	unsigned int to_submit = ring->sqe_tail - *ring->sq_tail;
+	unsigned int flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+	int ret;
+
+	__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	ret = io_uring_enter(ring->fd, to_submit, wait_nr, flags);
+	/* Interrupted while waiting: the SQEs have already been consumed */
+	while (ret < 0 && errno == EINTR)
+		ret = io_uring_enter(ring->fd, 0, wait_nr, flags);
+	return ret;
+}
+
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring)
+{
+	unsigned int head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+	return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(struct uring *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* HAVE_IO_URING */
@@ -0,0 +1,59 @@
+/*
+ * uring.h
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Minimal io_uring wrapper for the loopback tests, using the raw system
+ * calls so no liburing is needed in the BSP.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+struct uring {
+	int fd;
+	unsigned int features;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned int sqe_tail;		/* handed out, not yet submitted */
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_sz, cq_ring_sz, sqes_sz;
+};
+
+/* Returns -1 with errno set if the kernel has no (or a disabled) io_uring */
+int uring_init(struct uring *ring, unsigned int entries);
+void uring_exit(struct uring *ring);
+int uring_register_buffers(struct uring *ring, const struct iovec *iov,
+			   unsigned int nr);
+/* Zeroed SQE, or NULL if the submission queue is full */
+struct io_uring_sqe *uring_get_sqe(struct uring *ring);
+/* Free submission queue entries */
+unsigned int uring_sq_space(struct uring *ring);
+/* Submit queued SQEs and wait for at least wait_nr completions */
+int uring_submit(struct uring *ring, unsigned int wait_nr);
+/* Next completion, or NULL; release it with uring_cqe_seen() */
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring);
+void uring_cqe_seen(struct uring *ring);
+
+#endif /* HAVE_IO_URING */
+
+#endif /* URING_H */
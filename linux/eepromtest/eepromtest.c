@@ -0,0 +1,289 @@
+/*
+ * eepromtest.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * A test for the eeprom interface on ATC controller. Reads the whole
+ * device in page-sized chunks, checks the 2070-1C signature and the
+ * checksum of the complete image, and optionally runs a page-aligned
+ * save/pattern-write/verify/restore cycle, reporting throughput.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SIZE	(1 << 20)
+#define SIGNATURE	"2070-1C"
+#define SIGNATURE_OFF	7
+#define SAVE_FILE	"/tmp/eeprom.save"
+
+static const char *dev = "/dev/eeprom";
+static unsigned int page_size = 64;
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "eepromtest version 2.0\n"
+		"\n"
+		"Usage: eepromtest [-d device] [-P page_size] [-s size]"
+		" [-c crc32] [-u] [-w]\n"
+		"\n"
+		"  -c  expected CRC-32 of the complete image\n"
+		"  -u  initialize the EEPROM content with 'eeprom -u' first\n"
+		"  -w  save, pattern-write, verify and restore the EEPROM\n");
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t crc32(const unsigned char *buf, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+	size_t i;
+	int k;
+
+	for (i = 0; i < len; i++) {
+		crc ^= buf[i];
+		for (k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+/*
+ * Read up to size bytes page by page; returns the number of bytes read,
+ * or -1 on an error so a write test can still restore the EEPROM
+ */
+static ssize_t read_image(int fd, unsigned char *buf, size_t size)
+{
+	size_t count = 0;
+	ssize_t len;
+
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+		fprintf(stderr, "%s seek failed: %s\n", dev, strerror(errno));
+		return -1;
+	}
+	while (count < size) {
+		len = read(fd, buf + count, size - count < page_size ?
+			   size - count : page_size);
+		if (len < 0) {
+			fprintf(stderr, "%s read failed at %zu: %s\n", dev,
+				count, strerror(errno));
+			return -1;
+		}
+		if (len == 0)
+			break;
+		count += len;
+	}
+	return count;
+}
+
+/*
+ * Write the image one page per write() so no write crosses a page;
+ * returns -1 on an error
+ */
+static int write_image(int fd, const unsigned char *buf, size_t size)
+{
+	size_t count = 0;
+	ssize_t len;
+
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+		fprintf(stderr, "%s seek failed: %s\n", dev, strerror(errno));
+		return -1;
+	}
+	while (count < size) {
+		len = write(fd, buf + count, size - count < page_size ?
+			    size - count : page_size);
+		if (len <= 0) {
+			fprintf(stderr, "%s write failed at %zu: %s\n", dev,
+				count, len ? strerror(errno) : "short write");
+			return -1;
+		}
+		count += len;
+	}
+	if (fsync(fd)) {
+		fprintf(stderr, "%s sync failed: %s\n", dev, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int verify(const unsigned char *expect, const unsigned char *got,
+		  size_t size, const char *what)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		if (expect[i] != got[i]) {
+			printf("%s mismatch at offset %zu: "
+			       "wrote %02x read %02x\n", what, i, expect[i],
+			       got[i]);
+			return 1;
+		}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int size = MAX_SIZE, expect_crc = 0;
+	int have_crc = 0, init = 0, write_test = 0, failed = 0, fd, opt, pass;
+	unsigned char *image, *pattern, *check;
+	double start, secs;
+	size_t len, i;
+	ssize_t res;
+	uint32_t crc;
+	FILE *fp;
+	char dummy;
+
+	while ((opt = getopt(argc, argv, "d:P:s:c:uw")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'P':
+			if (sscanf(optarg, "%u%c", &page_size, &dummy) != 1 ||
+			    !page_size)
+				usage();
+			break;
+		case 's':
+			if (sscanf(optarg, "%u%c", &size, &dummy) != 1 ||
+			    !size || size > MAX_SIZE)
+				usage();
+			break;
+		case 'c':
+			if (sscanf(optarg, "%x%c", &expect_crc, &dummy) != 1)
+				usage();
+			have_crc = 1;
+			break;
+		case 'u':
+			init = 1;
+			break;
+		case 'w':
+			write_test = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	printf("EEPROM test\n");
+	if (init) {
+		printf("Initializing EEPROM content\n");
+		if (system("eeprom -u") != 0) {
+			printf("Failed\n");
+			exit(1);
+		}
+	}
+
+	if ((fd = open(dev, write_test ? O_RDWR : O_RDONLY)) < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", dev,
+			strerror(errno));
+		exit(1);
+	}
+	if (!(image = malloc(size)) || !(pattern = malloc(size)) ||
+	    !(check = malloc(size))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	printf("Reading EEPROM in %u-byte pages\n", page_size);
+	start = now();
+	if ((res = read_image(fd, image, size)) < 0) {
+		printf("Failed\n");
+		exit(1);
+	}
+	len = res;
+	secs = now() - start;
+	if (!len) {
+		printf("EEPROM is empty\nFailed\n");
+		exit(1);
+	}
+	crc = crc32(image, len);
+	printf("%zu bytes read in %.3f s (%.1f bytes/s), CRC-32 %08x\n", len,
+	       secs, len / secs, crc);
+
+	/* A second read must return the same image */
+	if (read_image(fd, check, len) != (ssize_t)len ||
+	    verify(image, check, len, "re-read"))
+		failed = 1;
+	if (have_crc && crc != expect_crc) {
+		printf("CRC-32 %08x, expected %08x\n", crc, expect_crc);
+		failed = 1;
+	}
+	if (len < SIGNATURE_OFF + strlen(SIGNATURE) ||
+	    memcmp(image + SIGNATURE_OFF, SIGNATURE, strlen(SIGNATURE))) {
+		printf("%s signature not found\n", SIGNATURE);
+		failed = 1;
+	}
+
+	if (write_test && !failed) {
+		printf("saving copy of EEPROM to %s\n", SAVE_FILE);
+		if (!(fp = fopen(SAVE_FILE, "w")) ||
+		    fwrite(image, 1, len, fp) != len || fclose(fp)) {
+			fprintf(stderr, "Unable to save %s: %s\n", SAVE_FILE,
+				strerror(errno));
+			exit(1);
+		}
+
+		/* Address-dependent pattern and its complement */
+		for (pass = 0; pass < 2 && !failed; pass++) {
+			for (i = 0; i < len; i++)
+				pattern[i] = ((i * 7 + (i >> 8)) ^
+					      (pass ? 0xa5 : 0x5a)) & 0xff;
+			start = now();
+			if (write_image(fd, pattern, len)) {
+				failed = 1;
+				break;
+			}
+			secs = now() - start;
+			printf("pattern %d: %zu bytes written in %.3f s "
+			       "(%.1f bytes/s)\n", pass + 1, len, secs,
+			       len / secs);
+			failed = read_image(fd, check, len) != (ssize_t)len ||
+				 verify(pattern, check, len, "pattern");
+		}
+
+		printf("restoring EEPROM from copy\n");
+		if (write_image(fd, image, len) ||
+		    read_image(fd, check, len) != (ssize_t)len ||
+		    verify(image, check, len, "restore") ||
+		    crc32(check, len) != crc) {
+			printf("EEPROM not restored, copy kept in %s\n",
+			       SAVE_FILE);
+			failed = 1;
+		} else {
+			unlink(SAVE_FILE);
+		}
+	}
+
+	close(fd);
+	free(image);
+	free(pattern);
+	free(check);
+	if (failed) {
+		printf("Failed\n");
+		exit(1);
+	}
+	printf("Passed\n");
+	exit(0);
+}
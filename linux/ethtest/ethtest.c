@@ -12,7 +12,13 @@
  * (at your option) any later version.
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,20 +26,47 @@
 #include <time.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <netpacket/packet.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/time.h>
+#include <linux/ethtool.h>
 #include <linux/if_ether.h>
 #include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 
+#include "lathist.h"
+#include "livestats.h"
+#include "perfcnt.h"
+#include "uring.h"
+
 int if_sock = -1;
+int perf_counters = 0;
+int counter_report = 0;
+int use_uring = 0;
+int load_mode = 0;
+int probe_priority = 6;
+int qdisc_bypass = 0;
+int rt_mode = 0;
+unsigned int flaps = 0;
+int rt_cpu[2] = { 0, 0 };
+struct livestats *stats = NULL;
+unsigned int udp_port = 0;
+char *tx_netns = NULL, *rx_netns = NULL;
+int netns_self = -1;
 struct ifreq *ifr_tab[2] = { NULL, NULL };
+struct ifreq *volatile flap_down = NULL;
 unsigned char *test_buffer = NULL;
 
 static void error(const char *format, ...) __attribute__ ((__noreturn__));
 static void usage(void) __attribute__ ((__noreturn__));
 static void ifconfig(struct ifreq *ifr, int up);
+static void flap_restore(void);
 
 static void error(const char *format, ...)
 {
@@ -44,6 +77,13 @@ static void error(const char *format, ...)
 	vfprintf(stderr, format, args);
 	va_end(args);
 
+	if (stats) {
+		livestats_begin(stats);
+		livestats_add(&stats->errors, 1);
+		livestats_end(stats);
+	}
+
+	flap_restore();
 
 	if ((ptr = ifr_tab[0])) {
 		ifr_tab[0] = NULL;
@@ -64,8 +104,29 @@ static void usage(void)
 {
 	fprintf(stderr, "ethtest version 1.0\n"
 		"\n"
-		"Usage: ethtest (ethX | ethX:ethY)"
-		" [number_of_packets [packet_size]]\n");
+		"Usage: ethtest [-c] [-p] [-s] [-U] [-u port -n txns:rxns]"
+		" [-l [-q prio] [-b]]\n"
+		"       [-R txcpu[:rxcpu]] [-F flaps]"
+		" (ethX | ethX:ethY) [number_of_packets [packet_size]]\n"
+		"\n"
+		"  -b  send the bulk stream with PACKET_QDISC_BYPASS\n"
+		"  -c  report driver, kernel and socket counter deltas\n"
+		"  -F  bounce ethX flaps times, timing carrier and first"
+		" looped frame\n"
+		"  -l  latency under load: number_of_packets probes, idle and\n"
+		"      next to a bulk stream of packet_size frames\n"
+		"  -p  report performance counters for the transfer loop\n"
+		"  -q  probe socket priority, the VLAN PCP via egress-qos-map"
+		" (6)\n"
+		"  -R  real-time mode: number_of_packets probes as an ordinary\n"
+		"      process, then busy-polling from pinned SCHED_FIFO"
+		" threads\n"
+		"  -s  publish live statistics under " LIVESTATS_DIR ", tx drops\n"
+		"      and lost frames count as errors (no latency in UDP mode)\n"
+		"  -U  use io_uring for the transfer loop if available\n"
+		"  -u  UDP mode (UDP_SEGMENT/UDP_GRO) to the given port\n"
+		"  -n  network namespaces of ethX and ethY in UDP mode, which\n"
+		"      must differ (required with -u)\n");
 	exit(1);
 }
 
@@ -75,8 +136,15 @@ static int tx(int sock, struct sockaddr_ll *addr, uint8_t *buffer,
 {
 	if (sendto(sock, buffer, packet_size, 0,
 		   (struct sockaddr*)addr, sizeof(struct sockaddr_ll)) < 0) {
-		if (errno == ENOBUFS)
+		if (errno == ENOBUFS) {
+			/* Dropped, sent again on the next pass */
+			if (stats) {
+				livestats_begin(stats);
+				livestats_add(&stats->errors, 1);
+				livestats_end(stats);
+			}
 			return 0;
+		}
 		error("sendto() failed: %s\n", strerror(errno));
 	}
 	return 1;
@@ -109,6 +177,223 @@ static int rx(int sock, struct sockaddr_ll *addr, uint8_t *buffer,
 	return len;
 }
 
+/* Columns of /proc/net/dev */
+#define DEV_FIELDS 16
+static const char *dev_field[DEV_FIELDS] = {
+	"rx_bytes", "rx_packets", "rx_errs", "rx_drop", "rx_fifo", "rx_frame",
+	"rx_compressed", "rx_multicast",
+	"tx_bytes", "tx_packets", "tx_errs", "tx_drop", "tx_fifo", "tx_colls",
+	"tx_carrier", "tx_compressed"
+};
+enum { RX_ERRS = 2, RX_DROP, RX_FIFO, RX_FRAME,
+       TX_ERRS = 10, TX_DROP, TX_FIFO, TX_COLLS, TX_CARRIER };
+
+/* Same layout as struct tpacket_stats in <linux/if_packet.h> */
+struct packet_stats {
+	unsigned int packets;
+	unsigned int drops;
+};
+
+struct if_snapshot {
+	unsigned long long dev[DEV_FIELDS];
+	struct ethtool_gstrings *strings;	/* NULL if driver has no stats */
+	struct ethtool_stats *stats;
+};
+
+struct kernel_snapshot {
+	unsigned long long net_tx, net_rx;	/* /proc/softirqs */
+	unsigned long long backlog_drops;	/* /proc/net/softnet_stat */
+	unsigned long long time_squeeze;
+};
+
+static void proc_net_dev(const char *name, unsigned long long *dev)
+{
+	char line[512], *p;
+	size_t len = strlen(name);
+	FILE *fp;
+	int i;
+
+	memset(dev, 0, DEV_FIELDS * sizeof(*dev));
+	if (!(fp = fopen("/proc/net/dev", "r"))) {
+		fprintf(stderr, "Unable to open /proc/net/dev: %s\n",
+			strerror(errno));
+		return;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		for (p = line; *p == ' '; p++)
+			;
+		if (strncmp(p, name, len) != 0 || p[len] != ':')
+			continue;
+		p += len + 1;
+		for (i = 0; i < DEV_FIELDS; i++)
+			dev[i] = strtoull(p, &p, 10);
+		break;
+	}
+	fclose(fp);
+}
+
+static int ethtool(const char *name, void *cmd)
+{
+	struct ifreq ifr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, name);
+	ifr.ifr_data = cmd;
+	return ioctl(if_sock, SIOCETHTOOL, &ifr);
+}
+
+static void if_snapshot(const char *name, struct if_snapshot *snap)
+{
+	struct ethtool_drvinfo drvinfo;
+	unsigned int n;
+
+	proc_net_dev(name, snap->dev);
+
+	snap->strings = NULL;
+	snap->stats = NULL;
+	memset(&drvinfo, 0, sizeof(drvinfo));
+	drvinfo.cmd = ETHTOOL_GDRVINFO;
+	if (ethtool(name, &drvinfo) || !(n = drvinfo.n_stats))
+		return;
+
+	snap->strings = calloc(1, sizeof(*snap->strings) + n * ETH_GSTRING_LEN);
+	snap->stats = calloc(1, sizeof(*snap->stats) + n * sizeof(__u64));
+	if (!snap->strings || !snap->stats)
+		error("Out of memory\n");
+	snap->strings->cmd = ETHTOOL_GSTRINGS;
+	snap->strings->string_set = ETH_SS_STATS;
+	snap->strings->len = n;
+	snap->stats->cmd = ETHTOOL_GSTATS;
+	snap->stats->n_stats = n;
+	if (ethtool(name, snap->strings) || ethtool(name, snap->stats)) {
+		fprintf(stderr, "Unable to read %s driver statistics: %s\n",
+			name, strerror(errno));
+		free(snap->strings);
+		free(snap->stats);
+		snap->strings = NULL;
+		snap->stats = NULL;
+	}
+}
+
+static void if_snapshot_free(struct if_snapshot *snap)
+{
+	free(snap->strings);
+	free(snap->stats);
+}
+
+static void kernel_snapshot(struct kernel_snapshot *snap)
+{
+	char line[4096], *p, *end;
+	unsigned long long *sum;
+	unsigned int processed, dropped, squeezed;
+	FILE *fp;
+
+	memset(snap, 0, sizeof(*snap));
+	if ((fp = fopen("/proc/softirqs", "r"))) {
+		while (fgets(line, sizeof(line), fp)) {
+			for (p = line; *p == ' '; p++)
+				;
+			if (strncmp(p, "NET_TX:", 7) == 0)
+				sum = &snap->net_tx;
+			else if (strncmp(p, "NET_RX:", 7) == 0)
+				sum = &snap->net_rx;
+			else
+				continue;
+			for (p += 7; ; p = end) {
+				unsigned long long v = strtoull(p, &end, 10);
+				if (end == p)
+					break;
+				*sum += v;
+			}
+		}
+		fclose(fp);
+	}
+	if ((fp = fopen("/proc/net/softnet_stat", "r"))) {
+		while (fscanf(fp, "%x %x %x%*[^\n]", &processed, &dropped,
+			      &squeezed) == 3) {
+			snap->backlog_drops += dropped;
+			snap->time_squeeze += squeezed;
+		}
+		fclose(fp);
+	}
+}
+
+static void if_report(const char *name, struct if_snapshot *before,
+		      struct if_snapshot *after)
+{
+	unsigned int i, n, changed = 0;
+
+	printf("%s /proc/net/dev:", name);
+	for (i = 0; i < DEV_FIELDS; i++)
+		if (after->dev[i] != before->dev[i])
+			printf(" %s %llu", dev_field[i],
+			       after->dev[i] - before->dev[i]);
+	printf("\n");
+
+	if (!before->stats || !after->stats ||
+	    before->stats->n_stats != after->stats->n_stats) {
+		printf("%s driver statistics: not available\n", name);
+		return;
+	}
+	printf("%s driver statistics (non-zero deltas):\n", name);
+	n = after->stats->n_stats;
+	for (i = 0; i < n; i++) {
+		if (after->stats->data[i] == before->stats->data[i])
+			continue;
+		printf("  %-32.*s %llu\n", ETH_GSTRING_LEN,
+		       (char *)&after->strings->data[i * ETH_GSTRING_LEN],
+		       (unsigned long long)(after->stats->data[i] -
+					    before->stats->data[i]));
+		changed++;
+	}
+	if (!changed)
+		printf("  none\n");
+}
+
+/*
+ * Print counter deltas and attribute any loss to the NIC/driver, the kernel
+ * receive backlog or the packet socket receive buffer.
+ */
+static void counters_report(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
+			    struct if_snapshot *if_before,
+			    struct if_snapshot *if_after,
+			    struct kernel_snapshot *kern_before,
+			    struct kernel_snapshot *kern_after,
+			    struct packet_stats *sock, unsigned int lost)
+{
+	struct if_snapshot *tx_b = &if_before[0], *tx_a = &if_after[0];
+	struct if_snapshot *rx_b = &if_before[1], *rx_a = &if_after[1];
+	unsigned long long nic, backlog, accounted;
+
+	if_report(tx_ifr->ifr_name, tx_b, tx_a);
+	if (rx_ifr != tx_ifr)
+		if_report(rx_ifr->ifr_name, rx_b, rx_a);
+	else
+		rx_b = tx_b, rx_a = tx_a;
+	printf("softirqs: NET_TX %llu NET_RX %llu\n",
+	       kern_after->net_tx - kern_before->net_tx,
+	       kern_after->net_rx - kern_before->net_rx);
+	backlog = kern_after->backlog_drops - kern_before->backlog_drops;
+	printf("softnet: backlog drops %llu time squeeze %llu\n", backlog,
+	       kern_after->time_squeeze - kern_before->time_squeeze);
+	printf("rx socket: packets %u drops %u\n", sock->packets, sock->drops);
+
+	nic = (tx_a->dev[TX_ERRS] - tx_b->dev[TX_ERRS]) +
+	      (tx_a->dev[TX_DROP] - tx_b->dev[TX_DROP]) +
+	      (tx_a->dev[TX_FIFO] - tx_b->dev[TX_FIFO]) +
+	      (tx_a->dev[TX_CARRIER] - tx_b->dev[TX_CARRIER]) +
+	      (rx_a->dev[RX_ERRS] - rx_b->dev[RX_ERRS]) +
+	      (rx_a->dev[RX_DROP] - rx_b->dev[RX_DROP]) +
+	      (rx_a->dev[RX_FIFO] - rx_b->dev[RX_FIFO]) +
+	      (rx_a->dev[RX_FRAME] - rx_b->dev[RX_FRAME]);
+	accounted = nic + backlog + sock->drops;
+	if (!lost && !accounted)
+		return;
+	printf("loss attribution: NIC/driver %llu, kernel backlog %llu,"
+	       " socket buffer %u, unaccounted %lld\n", nic, backlog,
+	       sock->drops, (long long)lost - (long long)accounted);
+}
+
 const unsigned char bcast[] = {0xff,0xff,0xff,0xff,0xff,0xff};
 const unsigned char test_packet[] = {
         0x3e, 0x54, 0x68, 0x65, 0x20, 0x71, 0x75, 0x69, 0x63, 0x6b,
@@ -117,6 +402,361 @@ const unsigned char test_packet[] = {
         0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x7e, 0x7c,
         0x61, 0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x3f, 0xfe};
 
+/*
+ * Send times of the frames in flight for the live latency statistics.
+ * Frames loop back in order, so received frame n is sent frame n.
+ */
+#define STATS_RING	4096
+struct timespec *stats_tx_time = NULL;
+
+static void stats_sent(unsigned int n)
+{
+	if (stats_tx_time)
+		clock_gettime(CLOCK_MONOTONIC, &stats_tx_time[n % STATS_RING]);
+}
+
+/* Frame n came back after sent frames have gone out; inside an update */
+static void stats_received(unsigned int n, unsigned int sent)
+{
+	struct timespec now, *tx;
+
+	if (!stats_tx_time || n >= sent || sent - n > STATS_RING)
+		return;
+	tx = &stats_tx_time[n % STATS_RING];
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	livestats_latency(stats, (now.tv_sec - tx->tv_sec) * 1000000000ULL +
+			  now.tv_nsec - tx->tv_nsec);
+}
+
+#ifdef HAVE_IO_URING
+#define URING_ENTRIES	256
+#define URING_DEPTH	32	/* sendmsg()s and recvmsg()s in flight */
+#define URING_BUFS	64	/* provided buffers for multishot recvmsg */
+#define URING_BGID	1
+
+#define URING_TAG(type, idx)	((__u64)(type) << 32 | (idx))
+#define URING_TYPE(tag)		((unsigned int)((tag) >> 32))
+#define URING_IDX(tag)		((unsigned int)(tag))
+
+enum { URING_TX = 1, URING_RX, URING_RX_MULTI, URING_PROVIDE, URING_TICK,
+       URING_CANCEL };
+
+struct uring_slot {
+	struct msghdr msg;
+	struct iovec iov;
+	struct sockaddr_ll addr;
+	uint8_t *buf;
+};
+
+static struct io_uring_sqe *eth_sqe(struct uring *ring)
+{
+	struct io_uring_sqe *sqe;
+
+	while (!(sqe = uring_get_sqe(ring)))
+		if (uring_submit(ring, 0) < 0)
+			error("io_uring_enter() failed: %s\n", strerror(errno));
+	return sqe;
+}
+
+static void eth_sqe_msg(struct uring *ring, int opcode, int sock,
+			struct msghdr *msg, __u64 tag)
+{
+	struct io_uring_sqe *sqe = eth_sqe(ring);
+
+	sqe->opcode = opcode;
+	sqe->fd = sock;
+	sqe->addr = (unsigned long)msg;
+	sqe->len = 1;
+	sqe->user_data = tag;
+}
+
+static void eth_sqe_provide(struct uring *ring, uint8_t *bufs,
+			    unsigned int size, unsigned int bid,
+			    unsigned int nr)
+{
+	struct io_uring_sqe *sqe = eth_sqe(ring);
+
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = nr;
+	sqe->addr = (unsigned long)(bufs + bid * size);
+	sqe->len = size;
+	sqe->off = bid;
+	sqe->buf_group = URING_BGID;
+	sqe->user_data = URING_TAG(URING_PROVIDE, bid);
+}
+
+/*
+ * io_uring version of the transfer loop. Up to URING_DEPTH sendmsg()s are
+ * kept in flight and receive uses one multishot recvmsg() on provided
+ * buffers, falling back to URING_DEPTH single-shot recvmsg()s on kernels
+ * without it, so each io_uring_enter() submits and reaps a whole batch.
+ * Returns -1 before sending anything if io_uring is unavailable.
+ */
+static int eth_loop_uring(int tx_sock, int rx_sock, struct sockaddr_ll *tx_addr,
+			  uint8_t *tx_buffer, unsigned int packet_size1,
+			  unsigned int packet_size2,
+			  unsigned int number_of_packets,
+			  unsigned int *tx_cnt, unsigned int *rx_cnt,
+			  unsigned long long *rx_bytes, struct timeval *rx_last)
+{
+	struct uring ring;
+	struct uring_slot tx_slot[URING_DEPTH], rx_slot[URING_DEPTH], multi;
+	struct io_uring_cqe *cqe;
+	struct io_uring_recvmsg_out *out;
+	struct __kernel_timespec tick = { 0, 100000000 };
+	struct timeval current;
+	struct sockaddr_ll *from;
+	uint8_t *rx_buffers, *bufs, *data;
+	unsigned int tx_free[URING_DEPTH], rx_free[URING_DEPTH];
+	unsigned int n_tx_free = URING_DEPTH, n_rx_free = URING_DEPTH;
+	unsigned int tx_queued = 0, packet_size = packet_size1;
+	unsigned int buf_size, max_len, idx, i;
+	int multishot = 1, multi_armed = 0, tick_armed = 0, len;
+
+	if (uring_init(&ring, URING_ENTRIES)) {
+		fprintf(stderr, "io_uring unavailable (%s), using sendto()/"
+			"recvfrom()\n", strerror(errno));
+		return -1;
+	}
+
+	max_len = packet_size1 > packet_size2 ? packet_size1 : packet_size2;
+	buf_size = max_len + sizeof(struct io_uring_recvmsg_out) +
+		    sizeof(struct sockaddr_ll);
+	if (!(rx_buffers = calloc(URING_DEPTH, buf_size)) ||
+	    !(bufs = calloc(URING_BUFS, buf_size)))
+		error("Out of memory\n");
+
+	for (i = 0; i < URING_DEPTH; i++) {
+		memset(&tx_slot[i], 0, sizeof(tx_slot[i]));
+		tx_slot[i].addr = *tx_addr;
+		tx_slot[i].iov.iov_base = tx_buffer;
+		tx_slot[i].msg.msg_name = &tx_slot[i].addr;
+		tx_slot[i].msg.msg_namelen = sizeof(struct sockaddr_ll);
+		tx_slot[i].msg.msg_iov = &tx_slot[i].iov;
+		tx_slot[i].msg.msg_iovlen = 1;
+		tx_free[i] = i;
+
+		memset(&rx_slot[i], 0, sizeof(rx_slot[i]));
+		rx_slot[i].buf = rx_buffers + i * buf_size;
+		rx_slot[i].iov.iov_base = rx_slot[i].buf;
+		rx_slot[i].iov.iov_len = buf_size;
+		rx_slot[i].msg.msg_name = &rx_slot[i].addr;
+		rx_slot[i].msg.msg_iov = &rx_slot[i].iov;
+		rx_slot[i].msg.msg_iovlen = 1;
+		rx_free[i] = i;
+	}
+	memset(&multi, 0, sizeof(multi));
+	multi.msg.msg_name = &multi.addr;
+	multi.msg.msg_namelen = sizeof(struct sockaddr_ll);
+	eth_sqe_provide(&ring, bufs, buf_size, 0, URING_BUFS);
+
+	while (*tx_cnt < number_of_packets || *rx_cnt < number_of_packets) {
+		while (tx_queued < number_of_packets && n_tx_free) {
+			idx = tx_free[--n_tx_free];
+			tx_slot[idx].iov.iov_len = packet_size;
+			eth_sqe_msg(&ring, IORING_OP_SENDMSG, tx_sock,
+				    &tx_slot[idx].msg, URING_TAG(URING_TX, idx));
+			tx_queued++;
+			packet_size = (packet_size == packet_size1) ?
+				      packet_size2 : packet_size1;
+		}
+		if (multishot && !multi_armed) {
+			struct io_uring_sqe *sqe = eth_sqe(&ring);
+
+			sqe->opcode = IORING_OP_RECVMSG;
+			sqe->fd = rx_sock;
+			sqe->addr = (unsigned long)&multi.msg;
+			sqe->ioprio = IORING_RECV_MULTISHOT;
+			sqe->flags = IOSQE_BUFFER_SELECT;
+			sqe->buf_group = URING_BGID;
+			sqe->user_data = URING_TAG(URING_RX_MULTI, 0);
+			multi_armed = 1;
+		}
+		while (!multishot && n_rx_free) {
+			idx = rx_free[--n_rx_free];
+			rx_slot[idx].msg.msg_namelen = sizeof(struct sockaddr_ll);
+			eth_sqe_msg(&ring, IORING_OP_RECVMSG, rx_sock,
+				    &rx_slot[idx].msg, URING_TAG(URING_RX, idx));
+		}
+		if (!tick_armed) {
+			struct io_uring_sqe *sqe = eth_sqe(&ring);
+
+			sqe->opcode = IORING_OP_TIMEOUT;
+			sqe->addr = (unsigned long)&tick;
+			sqe->len = 1;
+			sqe->user_data = URING_TAG(URING_TICK, 0);
+			tick_armed = 1;
+		}
+
+		if (uring_submit(&ring, 1) < 0)
+			error("io_uring_enter() failed: %s\n", strerror(errno));
+
+		for (; (cqe = uring_peek_cqe(&ring)); uring_cqe_seen(&ring)) {
+			idx = URING_IDX(cqe->user_data);
+			data = NULL;
+			len = cqe->res;
+
+			switch (URING_TYPE(cqe->user_data)) {
+			case URING_TX:
+				tx_free[n_tx_free++] = idx;
+				if (cqe->res >= 0) {
+					(*tx_cnt)++;
+					if (stats) {
+						stats_sent(*tx_cnt - 1);
+						livestats_begin(stats);
+						livestats_set(&stats->tx_packets,
+							      *tx_cnt);
+						livestats_add(&stats->tx_bytes,
+							      cqe->res);
+						livestats_end(stats);
+					}
+				} else if (cqe->res == -ENOBUFS ||
+					 cqe->res == -EAGAIN) {
+					tx_queued--;
+					if (stats && cqe->res == -ENOBUFS) {
+						livestats_begin(stats);
+						livestats_add(&stats->errors, 1);
+						livestats_end(stats);
+					}
+				} else
+					error("sendmsg() failed: %s\n",
+					      strerror(-cqe->res));
+				break;
+			case URING_RX:
+				rx_free[n_rx_free++] = idx;
+				if (cqe->res < 0)
+					error("recvmsg() failed: %s\n",
+					      strerror(-cqe->res));
+				from = &rx_slot[idx].addr;
+				data = rx_slot[idx].buf;
+				break;
+			case URING_RX_MULTI:
+				if (!(cqe->flags & IORING_CQE_F_MORE))
+					multi_armed = 0;
+				if (cqe->res == -ENOBUFS)
+					break;
+				if (cqe->res < 0 && !*rx_cnt &&
+				    (cqe->res == -EINVAL || cqe->res == -ENOENT)) {
+					fprintf(stderr, "multishot recvmsg "
+						"unavailable, using single-shot\n");
+					multishot = 0;
+					break;
+				}
+				if (cqe->res < 0)
+					error("recvmsg() failed: %s\n",
+					      strerror(-cqe->res));
+				i = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+				out = (void *)(bufs + i * buf_size);
+				from = (void *)(out + 1);
+				data = (uint8_t *)(out + 1) +
+				       multi.msg.msg_namelen;
+				/* A foreign frame larger than the buffer */
+				if (out->flags & MSG_TRUNC)
+					error("received frame truncated to %u "
+					      "bytes\n", out->payloadlen);
+				len = out->payloadlen;
+				eth_sqe_provide(&ring, bufs, buf_size, i, 1);
+				break;
+			case URING_PROVIDE:
+				if (cqe->res < 0 && multishot) {
+					fprintf(stderr, "provided buffers "
+						"unavailable, using single-shot\n");
+					multishot = 0;
+				}
+				break;
+			case URING_TICK:
+				tick_armed = 0;
+				break;
+			}
+
+			if (!data || from->sll_pkttype == PACKET_OUTGOING)
+				continue;
+			if (gettimeofday(rx_last, NULL))
+				error("gettimeofday() failed: %s\n",
+				      strerror(errno));
+			if ((unsigned int)len > max_len ||
+			    memcmp(tx_buffer, data, len) != 0)
+				error("rx packet %d differs from tx packet\n",
+				      *tx_cnt);
+			*rx_bytes += len;
+			(*rx_cnt)++;
+			if (stats) {
+				livestats_begin(stats);
+				stats_received(*rx_cnt - 1, *tx_cnt);
+				livestats_set(&stats->rx_packets, *rx_cnt);
+				livestats_set(&stats->rx_bytes, *rx_bytes);
+				livestats_end(stats);
+			}
+		}
+
+		if (*tx_cnt == number_of_packets) {
+			if (gettimeofday(&current, NULL))
+				error("gettimeofday() failed: %s\n",
+				      strerror(errno));
+			if (current.tv_sec - rx_last->tv_sec +
+			    (current.tv_usec - rx_last->tv_usec) /
+			    1000000 > 2) /* timeout 2 s */
+				break;
+		}
+	}
+
+	/* Cancel outstanding receives and the tick before freeing buffers */
+	for (i = 0; i < URING_DEPTH; i++) {
+		int busy = 1;
+		unsigned int j;
+
+		for (j = 0; j < n_rx_free; j++)
+			if (rx_free[j] == i)
+				busy = 0;
+		if (!multishot && busy) {
+			struct io_uring_sqe *sqe = eth_sqe(&ring);
+
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = URING_TAG(URING_RX, i);
+			sqe->user_data = URING_TAG(URING_CANCEL, 0);
+		}
+	}
+	if (multi_armed) {
+		struct io_uring_sqe *sqe = eth_sqe(&ring);
+
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = URING_TAG(URING_RX_MULTI, 0);
+		sqe->user_data = URING_TAG(URING_CANCEL, 0);
+	}
+	if (tick_armed) {
+		struct io_uring_sqe *sqe = eth_sqe(&ring);
+
+		sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+		sqe->addr = URING_TAG(URING_TICK, 0);
+		sqe->user_data = URING_TAG(URING_CANCEL, 0);
+	}
+	while ((!multishot && n_rx_free < URING_DEPTH) || multi_armed ||
+	       tick_armed) {
+		if (uring_submit(&ring, 1) < 0)
+			error("io_uring_enter() failed: %s\n", strerror(errno));
+		for (; (cqe = uring_peek_cqe(&ring)); uring_cqe_seen(&ring)) {
+			switch (URING_TYPE(cqe->user_data)) {
+			case URING_RX:
+				rx_free[n_rx_free++] = URING_IDX(cqe->user_data);
+				break;
+			case URING_RX_MULTI:
+				if (!(cqe->flags & IORING_CQE_F_MORE))
+					multi_armed = 0;
+				break;
+			case URING_TICK:
+				tick_armed = 0;
+				break;
+			}
+		}
+	}
+
+	uring_exit(&ring);
+	free(rx_buffers);
+	free(bufs);
+	return 0;
+}
+#endif /* HAVE_IO_URING */
+
 static void eth_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
 	       unsigned number_of_packets, unsigned packet_size1,
 	       unsigned packet_size2)
@@ -127,6 +767,12 @@ static void eth_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
 	int tx_sock, rx_sock;
 	struct timespec ts;
 	struct timeval tx_first, rx_last, current;
+	struct perfcnt pc;
+	unsigned long long rx_bytes = 0;
+	struct if_snapshot if_before[2], if_after[2];
+	struct kernel_snapshot kern_before, kern_after;
+	struct packet_stats sock_stats;
+	socklen_t optlen = sizeof(sock_stats);
         unsigned int i = 0, j = 0, packet_size;
 
 	packet_size = packet_size1;
@@ -171,16 +817,45 @@ static void eth_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
 	ts.tv_sec = 0;
 	ts.tv_nsec = 1000000;
 
+	if (counter_report) {
+		if_snapshot(tx_ifr->ifr_name, &if_before[0]);
+		if (rx_ifr != tx_ifr)
+			if_snapshot(rx_ifr->ifr_name, &if_before[1]);
+		kernel_snapshot(&kern_before);
+		/* Reading PACKET_STATISTICS resets it */
+		getsockopt(rx_sock, SOL_PACKET, PACKET_STATISTICS,
+			   &sock_stats, &optlen);
+	}
+
+	if (perf_counters) {
+		perfcnt_open(&pc);
+		perfcnt_start(&pc);
+	}
+
+	if (stats && !(stats_tx_time = calloc(STATS_RING,
+					      sizeof(*stats_tx_time))))
+		error("Out of memory\n");
 	if (gettimeofday(&tx_first, NULL))
 		error("gettimeofday() failed: %s\n", strerror(errno));
 	rx_last = tx_first;
 
+#ifdef HAVE_IO_URING
+	if (use_uring &&
+	    eth_loop_uring(tx_sock, rx_sock, &tx_addr, tx_buffer, packet_size1,
+			   packet_size2, number_of_packets, &tx_cnt, &rx_cnt,
+			   &rx_bytes, &rx_last) == 0)
+		goto loop_done;
+#endif
+
 	packet_size = packet_size1;
 	while (tx_cnt < number_of_packets || rx_cnt < number_of_packets) {
 		int t = 0, r = 0;
 
-		if (tx_cnt < number_of_packets)
+		if (tx_cnt < number_of_packets) {
 			t = tx(tx_sock, &tx_addr, tx_buffer, packet_size);
+			if (t)
+				stats_sent(tx_cnt);
+		}
 
 		r = rx(rx_sock, &rx_addr, rx_buffer, packet_size);
 		if (r) {
@@ -189,10 +864,21 @@ static void eth_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
 				      strerror(errno));
                         if (memcmp(tx_buffer, rx_buffer, r) != 0)
                                 error("rx packet %d differs from tx packet\n", tx_cnt);
+			rx_bytes += r;
                         r = 1;
                 }
 		tx_cnt += t;
 		rx_cnt += r;
+		if (stats) {
+			livestats_begin(stats);
+			if (r)
+				stats_received(rx_cnt - 1, tx_cnt);
+			livestats_set(&stats->tx_packets, tx_cnt);
+			livestats_add(&stats->tx_bytes, t * packet_size);
+			livestats_set(&stats->rx_packets, rx_cnt);
+			livestats_set(&stats->rx_bytes, rx_bytes);
+			livestats_end(stats);
+		}
 
 		if (!t && !r) {
 			if (tx_cnt == number_of_packets) {
@@ -209,6 +895,31 @@ static void eth_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
 		packet_size = (packet_size == packet_size1)?packet_size2:packet_size1;
 	}
 
+#ifdef HAVE_IO_URING
+loop_done:
+#endif
+	if (perf_counters)
+		perfcnt_stop(&pc);
+	/* Frames still missing at the receive timeout */
+	if (stats && rx_cnt < tx_cnt) {
+		livestats_begin(stats);
+		livestats_add(&stats->errors, tx_cnt - rx_cnt);
+		livestats_end(stats);
+	}
+	free(stats_tx_time);
+	stats_tx_time = NULL;
+
+	if (counter_report) {
+		optlen = sizeof(sock_stats);
+		if (getsockopt(rx_sock, SOL_PACKET, PACKET_STATISTICS,
+			       &sock_stats, &optlen))
+			memset(&sock_stats, 0, sizeof(sock_stats));
+		kernel_snapshot(&kern_after);
+		if_snapshot(tx_ifr->ifr_name, &if_after[0]);
+		if (rx_ifr != tx_ifr)
+			if_snapshot(rx_ifr->ifr_name, &if_after[1]);
+	}
+
 	close(tx_sock);
 	close(rx_sock);
         free(tx_buffer);
@@ -222,11 +933,1170 @@ static void eth_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
 		       (packet_size + sizeof(struct ethhdr)) * 10 * rx_cnt /
 		       ((rx_last.tv_sec - tx_first.tv_sec) * 1000.0 +
 			(rx_last.tv_usec - tx_first.tv_usec) / 1000.0));
+	if (perf_counters) {
+		perfcnt_report(&pc, rx_cnt, rx_bytes);
+		perfcnt_close(&pc);
+	}
+	if (counter_report) {
+		counters_report(tx_ifr, rx_ifr, if_before, if_after,
+				&kern_before, &kern_after, &sock_stats,
+				tx_cnt - rx_cnt);
+		if_snapshot_free(&if_before[0]);
+		if_snapshot_free(&if_after[0]);
+		if (rx_ifr != tx_ifr) {
+			if_snapshot_free(&if_before[1]);
+			if_snapshot_free(&if_after[1]);
+		}
+	}
         if (rx_cnt != tx_cnt)
                 error("packet loss occurred\n");
 }
 
 
+/* Largest UDP GSO send: UDP_MAX_SEGMENTS and the 64k datagram limit */
+#define UDP_MAX_SEGS	64
+#define UDP_MAX_LEN	65000
+/* A GRO batch can reach the 65507-byte UDP payload limit */
+#define UDP_RX_LEN	65536
+/* IPv4 and UDP headers in front of each GSO segment */
+#define UDP_HDR_LEN	28
+
+/* Switch to a named network namespace, or back to our own if ns is NULL */
+static void netns_enter(const char *ns)
+{
+	char path[64 + NAME_MAX];
+	int fd = netns_self;
+
+	if (ns) {
+		snprintf(path, sizeof(path), "/var/run/netns/%s", ns);
+		if ((fd = open(path, O_RDONLY)) < 0)
+			error("Unable to open network namespace %s: %s\n", ns,
+			      strerror(errno));
+	}
+	if (setns(fd, CLONE_NEWNET))
+		error("Unable to enter network namespace %s: %s\n",
+		      ns ? ns : "(self)", strerror(errno));
+	if (ns)
+		close(fd);
+}
+
+/* UDP socket created in network namespace ns and bound to ifr's device */
+static int udp_socket(const char *ns, struct ifreq *ifr,
+		      struct sockaddr_in *addr, int *mtu)
+{
+	struct ifreq req;
+	int sock;
+
+	if (ns)
+		netns_enter(ns);
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+		error("socket() failed: %s\n", strerror(errno));
+	memset(&req, 0, sizeof(req));
+	strcpy(req.ifr_name, ifr->ifr_name);
+	if (ioctl(sock, SIOCGIFADDR, &req))
+		error("Unable to get %s IPv4 address: %s\n", ifr->ifr_name,
+		      strerror(errno));
+	memcpy(addr, &req.ifr_addr, sizeof(*addr));
+	if (mtu) {
+		if (ioctl(sock, SIOCGIFMTU, &req))
+			error("Unable to get %s MTU: %s\n", ifr->ifr_name,
+			      strerror(errno));
+		*mtu = req.ifr_mtu;
+	}
+	if (setsockopt(sock, SOL_SOCKET, SO_BINDTODEVICE, ifr->ifr_name,
+		       strlen(ifr->ifr_name) + 1))
+		error("Unable to bind to %s: %s\n", ifr->ifr_name,
+		      strerror(errno));
+	if (ns)
+		netns_enter(NULL);
+	return sock;
+}
+
+static int udp_tx(int sock, uint8_t *buffer, unsigned int packet_size,
+		  unsigned int segs, int gso)
+{
+	char control[CMSG_SPACE(sizeof(uint16_t))];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	iov.iov_base = buffer;
+	iov.iov_len = packet_size * segs;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (gso) {
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		*(uint16_t *)CMSG_DATA(cmsg) = packet_size;
+	}
+	if (sendmsg(sock, &msg, MSG_DONTWAIT) < 0) {
+		if (errno == ENOBUFS && stats) {
+			livestats_begin(stats);
+			livestats_add(&stats->errors, 1);
+			livestats_end(stats);
+		}
+		if (errno == ENOBUFS || errno == EAGAIN)
+			return 0;
+		error("sendmsg() failed: %s\n", strerror(errno));
+	}
+	return segs;
+}
+
+/* Returns the number of datagrams received, split from a GRO batch */
+static int udp_rx(int sock, uint8_t *buffer, const uint8_t *pattern,
+		  unsigned long long *bytes)
+{
+	char control[CMSG_SPACE(sizeof(int))];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t len, off, seg;
+	int gso_size = 0, cnt = 0;
+
+	iov.iov_base = buffer;
+	iov.iov_len = UDP_RX_LEN;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	if ((len = recvmsg(sock, &msg, MSG_DONTWAIT)) < 0) {
+		if (errno == EAGAIN)
+			return 0;
+		error("recvmsg() failed: %s\n", strerror(errno));
+	}
+	if (msg.msg_flags & MSG_TRUNC)
+		error("received UDP batch truncated to %zd bytes\n", len);
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+			memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+	if (gso_size <= 0)
+		gso_size = len;
+
+	for (off = 0; off < len; off += gso_size) {
+		seg = len - off < gso_size ? len - off : gso_size;
+		if (memcmp(pattern, buffer + off, seg) != 0)
+			error("rx datagram differs from tx datagram\n");
+		cnt++;
+	}
+	*bytes += len;
+	return cnt;
+}
+
+/*
+ * UDP throughput through the IP stack. Within one network namespace the
+ * kernel routes traffic between two local addresses over loopback, so
+ * ethX and ethY (or the veth peers) must be in different namespaces.
+ */
+static void udp_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
+		     unsigned number_of_packets, unsigned packet_size1,
+		     unsigned packet_size2)
+{
+	struct sockaddr_in tx_addr, rx_addr;
+	uint8_t *tx_buffer[2], *rx_buffer;
+	unsigned int tx_cnt = 0, rx_cnt = 0, max_segs[2], segs;
+	unsigned long long rx_bytes = 0;
+	int tx_sock, rx_sock, gso = 1, gro = 1, one = 1, rcvbuf = 1 << 22;
+	int cur = 0, mtu, seg_gso[2], zero = 0;
+	struct timespec ts;
+	struct timeval tx_first, rx_last, current;
+	struct rusage ru_start, ru_end;
+	struct perfcnt pc;
+	unsigned int i, k, packet_size[2];
+	double ms, cpu;
+
+	packet_size[0] = packet_size1;
+	packet_size[1] = packet_size2;
+	for (k = 0; k < 2; k++)
+		if (packet_size[k] == 0 || packet_size[k] > UDP_MAX_LEN)
+			error("Invalid UDP packet size %u\n", packet_size[k]);
+	if (!(rx_buffer = malloc(UDP_RX_LEN)))
+		error("Out of memory\n");
+
+	rx_sock = udp_socket(rx_netns, rx_ifr, &rx_addr, NULL);
+	rx_addr.sin_port = htons(udp_port);
+	if (bind(rx_sock, (struct sockaddr*)&rx_addr, sizeof(rx_addr)) < 0)
+		error("bind() failed: %s\n", strerror(errno));
+	if (setsockopt(rx_sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+		       sizeof(rcvbuf)))
+		setsockopt(rx_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+			   sizeof(rcvbuf));
+	if (setsockopt(rx_sock, SOL_UDP, UDP_GRO, &one, sizeof(one))) {
+		fprintf(stderr, "UDP_GRO unavailable: %s\n", strerror(errno));
+		gro = 0;
+	}
+
+	tx_sock = udp_socket(tx_netns, tx_ifr, &tx_addr, &mtu);
+	tx_addr.sin_port = 0;
+	if (bind(tx_sock, (struct sockaddr*)&tx_addr, sizeof(tx_addr)) < 0)
+		error("bind() failed: %s\n", strerror(errno));
+	if (connect(tx_sock, (struct sockaddr*)&rx_addr, sizeof(rx_addr)) < 0)
+		error("connect() failed: %s\n", strerror(errno));
+	/* Only probe for support: the segment size goes in each sendmsg() */
+	if (setsockopt(tx_sock, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero))) {
+		fprintf(stderr, "UDP_SEGMENT unavailable: %s\n",
+			strerror(errno));
+		gso = 0;
+	}
+
+	/*
+	 * A GSO segment must fit the MTU, so larger datagrams are sent one
+	 * at a time without UDP_SEGMENT and left to IP fragmentation.
+	 */
+	for (k = 0; k < 2; k++) {
+		seg_gso[k] = gso && packet_size[k] <= (unsigned int)mtu -
+						      UDP_HDR_LEN;
+		if (gso && !seg_gso[k] &&
+		    (k == 0 || packet_size[1] != packet_size[0]))
+			fprintf(stderr, "%u-byte datagrams exceed %s MTU %d, "
+				"sent without GSO\n", packet_size[k],
+				tx_ifr->ifr_name, mtu);
+		max_segs[k] = seg_gso[k] ? UDP_MAX_LEN / packet_size[k] : 1;
+		if (max_segs[k] > UDP_MAX_SEGS)
+			max_segs[k] = UDP_MAX_SEGS;
+		if (!(tx_buffer[k] = malloc(packet_size[k] * max_segs[k])))
+			error("Out of memory\n");
+		/* every segment starts with the test pattern */
+		for (i = 0; i < packet_size[k] * max_segs[k]; i++)
+			tx_buffer[k][i] = test_packet[(i % packet_size[k]) %
+						      sizeof(test_packet)];
+	}
+	printf("UDP mode: GSO %s, GRO %s\n", gso ? "on" : "off",
+	       gro ? "on" : "off");
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = 1000000;
+
+	if (perf_counters) {
+		perfcnt_open(&pc);
+		perfcnt_start(&pc);
+	}
+	getrusage(RUSAGE_SELF, &ru_start);
+
+	if (gettimeofday(&tx_first, NULL))
+		error("gettimeofday() failed: %s\n", strerror(errno));
+	rx_last = tx_first;
+
+	while (tx_cnt < number_of_packets || rx_cnt < number_of_packets) {
+		int t = 0, r = 0;
+
+		if (tx_cnt < number_of_packets) {
+			segs = number_of_packets - tx_cnt;
+			if (segs > max_segs[cur])
+				segs = max_segs[cur];
+			t = udp_tx(tx_sock, tx_buffer[cur], packet_size[cur],
+				   segs, seg_gso[cur]);
+		}
+
+		r = udp_rx(rx_sock, rx_buffer, tx_buffer[0], &rx_bytes);
+		if (r) {
+			if (gettimeofday(&rx_last, NULL))
+				error("gettimeofday() failed: %s\n",
+				      strerror(errno));
+		}
+		tx_cnt += t;
+		rx_cnt += r;
+		if (stats) {
+			livestats_begin(stats);
+			livestats_set(&stats->tx_packets, tx_cnt);
+			livestats_add(&stats->tx_bytes, t * packet_size[cur]);
+			livestats_set(&stats->rx_packets, rx_cnt);
+			livestats_set(&stats->rx_bytes, rx_bytes);
+			livestats_end(stats);
+		}
+
+		if (!t && !r) {
+			if (tx_cnt == number_of_packets) {
+				if (gettimeofday(&current, NULL))
+					error("gettimeofday() failed: %s\n",
+					      strerror(errno));
+				if (current.tv_sec - rx_last.tv_sec +
+				    (current.tv_usec - rx_last.tv_usec) /
+				    1000000 > 2) /* timeout 2 s */
+					break;
+			}
+			nanosleep(&ts, NULL);
+		}
+		if (t)
+			cur = !cur;
+	}
+
+	getrusage(RUSAGE_SELF, &ru_end);
+	if (perf_counters)
+		perfcnt_stop(&pc);
+	/* Datagrams still missing at the receive timeout */
+	if (stats && rx_cnt < tx_cnt) {
+		livestats_begin(stats);
+		livestats_add(&stats->errors, tx_cnt - rx_cnt);
+		livestats_end(stats);
+	}
+
+	close(tx_sock);
+	close(rx_sock);
+	free(tx_buffer[0]);
+	free(tx_buffer[1]);
+	free(rx_buffer);
+	printf("%u datagram%s sent to %s\n%u datagram%s received from %s\n",
+	       tx_cnt, tx_cnt != 1 ? "s" : "", tx_ifr->ifr_name,
+	       rx_cnt, rx_cnt != 1 ? "s" : "", rx_ifr->ifr_name);
+	ms = (rx_last.tv_sec - tx_first.tv_sec) * 1000.0 +
+	     (rx_last.tv_usec - tx_first.tv_usec) / 1000.0;
+	cpu = (ru_end.ru_utime.tv_sec - ru_start.ru_utime.tv_sec) +
+	      (ru_end.ru_utime.tv_usec - ru_start.ru_utime.tv_usec) / 1e6 +
+	      (ru_end.ru_stime.tv_sec - ru_start.ru_stime.tv_sec) +
+	      (ru_end.ru_stime.tv_usec - ru_start.ru_stime.tv_usec) / 1e6;
+	if (rx_cnt && ms > 0) {
+		printf("approximate UDP payload throughput: %.3f kbps\n",
+		       rx_bytes * 8 / ms);
+		printf("CPU time: %.3f s, %.3f CPU-s per Gbit\n", cpu,
+		       cpu / (rx_bytes * 8 / 1e9));
+	}
+	if (perf_counters) {
+		perfcnt_report(&pc, rx_cnt, rx_bytes);
+		perfcnt_close(&pc);
+	}
+	if (rx_cnt != tx_cnt)
+		error("packet loss occurred\n");
+}
+
+
+/*
+ * Latency under load: timestamped probes on their own ethertype and socket
+ * priority, first on an idle link and then next to a bulk stream sent at
+ * priority 0 from a second thread. On a VLAN device the socket priority
+ * becomes the PCP through the device's egress-qos-map.
+ */
+#define PROBE_MAGIC	0x50524f42	/* "PROB" */
+#define PROBE_SIZE	64
+#define PROBE_INTERVAL	1000000		/* ns between probes */
+#define PROBE_DRAIN	100		/* ms to wait for late probes */
+#define BULK_WARMUP	100000000	/* ns of bulk traffic before probing */
+#define RT_PRIORITY	80
+#define BUSY_POLL_US	50
+#define RT_SETTLE	100000000	/* ns for the receiver to start */
+#define PREFAULT_STACK	(64 * 1024)
+
+struct probe {
+	uint32_t magic;
+	uint32_t phase;
+	uint32_t seq;
+	uint32_t pad;
+	uint64_t tx_ns;			/* CLOCK_REALTIME, as SO_TIMESTAMPNS */
+};
+
+struct bulk {
+	int sock;
+	struct sockaddr_ll addr;
+	uint8_t *buffer;
+	unsigned int packet_size;
+	int stop;
+	unsigned long long sent;
+};
+
+struct probe_receiver {
+	int sock;
+	int cpu;
+	uint32_t phase;
+	uint64_t deadline;
+	struct lathist *h;
+	unsigned int seen;
+};
+
+static uint64_t realtime_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *bulk_thread(void *arg)
+{
+	struct bulk *bulk = arg;
+
+	while (!__atomic_load_n(&bulk->stop, __ATOMIC_RELAXED)) {
+		if (sendto(bulk->sock, bulk->buffer, bulk->packet_size, 0,
+			   (struct sockaddr *)&bulk->addr,
+			   sizeof(bulk->addr)) < 0) {
+			if (errno != ENOBUFS && errno != EAGAIN)
+				error("bulk sendto() failed: %s\n",
+				      strerror(errno));
+			sched_yield();
+			continue;
+		}
+		bulk->sent++;
+	}
+	return NULL;
+}
+
+/*
+ * Receive probes of this phase until deadline; returns the number seen.
+ * With busy set the socket is spun on instead of sleeping in poll().
+ */
+static unsigned int probe_rx(int sock, uint32_t phase, uint64_t deadline,
+			     struct lathist *h, int busy)
+{
+	uint8_t buffer[PROBE_SIZE], control[CMSG_SPACE(sizeof(struct timespec))];
+	struct probe *probe = (struct probe *)buffer;
+	struct sockaddr_ll from;
+	struct iovec iov = { buffer, sizeof(buffer) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct timespec *ts;
+	struct pollfd pfd = { .fd = sock, .events = POLLIN };
+	uint64_t now, rx_ns;
+	unsigned int seen = 0;
+	int timeout;
+
+	while ((now = realtime_ns()) < deadline) {
+		if (!busy) {
+			timeout = (deadline - now + 999999) / 1000000;
+			if (poll(&pfd, 1, timeout) <= 0)
+				continue;
+		}
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &from;
+		msg.msg_namelen = sizeof(from);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(sock, &msg, MSG_DONTWAIT) < (ssize_t)sizeof(*probe))
+			continue;
+		if (from.sll_pkttype == PACKET_OUTGOING ||
+		    probe->magic != PROBE_MAGIC || probe->phase != phase)
+			continue;
+		rx_ns = 0;
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg))
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+			    cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+				ts = (struct timespec *)CMSG_DATA(cmsg);
+				rx_ns = ts->tv_sec * 1000000000ULL +
+					ts->tv_nsec;
+			}
+		if (!rx_ns)
+			rx_ns = realtime_ns();
+		lathist_add(h, rx_ns > probe->tx_ns ? rx_ns - probe->tx_ns : 0);
+		if (stats) {
+			livestats_begin(stats);
+			livestats_add(&stats->rx_packets, 1);
+			livestats_add(&stats->rx_bytes, PROBE_SIZE);
+			livestats_latency(stats, rx_ns > probe->tx_ns ?
+					  rx_ns - probe->tx_ns : 0);
+			livestats_end(stats);
+		}
+		seen++;
+	}
+	return seen;
+}
+
+/*
+ * Send count probes at PROBE_INTERVAL and return the number lost. With
+ * rx_sock < 0 another thread receives them and this one only paces.
+ */
+static unsigned int probe_phase(int tx_sock, struct sockaddr_ll *addr,
+				int rx_sock, uint32_t phase, unsigned int count,
+				struct lathist *h, int busy)
+{
+	uint8_t buffer[PROBE_SIZE];
+	struct probe *probe = (struct probe *)buffer;
+	unsigned int seq, seen = 0;
+	uint64_t next = realtime_ns();
+	struct timespec ts;
+
+	memset(buffer, 0, sizeof(buffer));
+	probe->magic = PROBE_MAGIC;
+	probe->phase = phase;
+	for (seq = 0; seq < count; seq++) {
+		probe->seq = seq;
+		probe->tx_ns = realtime_ns();
+		if (sendto(tx_sock, buffer, sizeof(buffer), 0,
+			   (struct sockaddr *)addr, sizeof(*addr)) < 0 &&
+		    errno != ENOBUFS)
+			error("probe sendto() failed: %s\n", strerror(errno));
+		if (stats) {
+			livestats_begin(stats);
+			livestats_add(&stats->tx_packets, 1);
+			livestats_add(&stats->tx_bytes, PROBE_SIZE);
+			livestats_end(stats);
+		}
+		next += PROBE_INTERVAL;
+		if (rx_sock >= 0) {
+			seen += probe_rx(rx_sock, phase, next, h, busy);
+			continue;
+		}
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts,
+				       NULL) == EINTR)
+			;
+	}
+	if (rx_sock < 0)
+		return 0;
+	seen += probe_rx(rx_sock, phase,
+			 realtime_ns() + PROBE_DRAIN * 1000000ULL, h, busy);
+	return count - seen;
+}
+
+/* Probe destination, sender at probe_priority and timestamping receiver */
+static void probe_open(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
+		       struct sockaddr_ll *addr, int *tx_sock, int *rx_sock)
+{
+	struct sockaddr_ll rx_addr;
+	int one = 1;
+
+	if (ioctl(if_sock, SIOCGIFINDEX, tx_ifr))
+		error("Unable to get %s device index: %s\n", tx_ifr->ifr_name,
+		      strerror(errno));
+	if (ioctl(if_sock, SIOCGIFINDEX, rx_ifr))
+		error("Unable to get %s device index: %s\n", rx_ifr->ifr_name,
+		      strerror(errno));
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sll_family = AF_PACKET;
+	addr->sll_protocol = htons(ETH_P_802_EX1);
+	addr->sll_ifindex = tx_ifr->ifr_ifindex;
+	addr->sll_halen = ETH_ALEN;
+	memcpy(addr->sll_addr, bcast, ETH_ALEN);
+
+	memset(&rx_addr, 0, sizeof(rx_addr));
+	rx_addr.sll_family = AF_PACKET;
+	rx_addr.sll_protocol = htons(ETH_P_802_EX1);
+	rx_addr.sll_ifindex = rx_ifr->ifr_ifindex;
+
+	if ((*tx_sock = socket(PF_PACKET, SOCK_DGRAM, 0)) < 0 ||
+	    (*rx_sock = socket(PF_PACKET, SOCK_DGRAM,
+			       htons(ETH_P_802_EX1))) < 0)
+		error("socket() failed\n");
+	if (bind(*rx_sock, (struct sockaddr *)&rx_addr, sizeof(rx_addr)) < 0)
+		error("bind() failed\n");
+	if (setsockopt(*rx_sock, SOL_SOCKET, SO_TIMESTAMPNS, &one,
+		       sizeof(one)))
+		error("SO_TIMESTAMPNS failed: %s\n", strerror(errno));
+	if (setsockopt(*tx_sock, SOL_SOCKET, SO_PRIORITY, &probe_priority,
+		       sizeof(probe_priority)))
+		error("SO_PRIORITY failed: %s\n", strerror(errno));
+}
+
+static void load_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
+		      unsigned int number_of_probes, unsigned int packet_size)
+{
+	struct sockaddr_ll probe_addr;
+	struct lathist idle, loaded;
+	struct bulk bulk;
+	struct timespec warmup = { 0, BULK_WARMUP }, start, end;
+	pthread_t thread;
+	unsigned int lost_idle, lost_loaded, i;
+	uint64_t idle_p99;
+	int probe_sock, rx_sock, one = 1, zero = 0, res;
+	double secs;
+
+	probe_open(tx_ifr, rx_ifr, &probe_addr, &probe_sock, &rx_sock);
+
+	memset(&bulk, 0, sizeof(bulk));
+	bulk.addr = probe_addr;
+	bulk.addr.sll_protocol = htons(ETH_P_802_2);
+	if ((bulk.sock = socket(PF_PACKET, SOCK_DGRAM, 0)) < 0)
+		error("socket() failed\n");
+	if (setsockopt(bulk.sock, SOL_SOCKET, SO_PRIORITY, &zero,
+		       sizeof(zero)))
+		error("SO_PRIORITY failed: %s\n", strerror(errno));
+	if (qdisc_bypass &&
+	    setsockopt(bulk.sock, SOL_PACKET, PACKET_QDISC_BYPASS, &one,
+		       sizeof(one)))
+		error("PACKET_QDISC_BYPASS failed: %s\n", strerror(errno));
+
+	if (!(bulk.buffer = malloc(packet_size)))
+		error("Out of memory\n");
+	for (i = 0; i < packet_size; i++)
+		bulk.buffer[i] = test_packet[i % sizeof(test_packet)];
+	bulk.packet_size = packet_size;
+
+	printf("latency under load: probe priority %d, bulk priority 0, "
+	       "%u-byte bulk frames, qdisc bypass %s\n", probe_priority,
+	       packet_size, qdisc_bypass ? "on" : "off");
+	lathist_init(&idle);
+	lathist_init(&loaded);
+
+	lost_idle = probe_phase(probe_sock, &probe_addr, rx_sock, 1,
+				number_of_probes, &idle, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if ((res = pthread_create(&thread, NULL, bulk_thread, &bulk)))
+		error("pthread_create() failed: %s\n", strerror(res));
+	nanosleep(&warmup, NULL);
+	lost_loaded = probe_phase(probe_sock, &probe_addr, rx_sock, 2,
+				  number_of_probes, &loaded, 0);
+	__atomic_store_n(&bulk.stop, 1, __ATOMIC_RELAXED);
+	pthread_join(thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	close(bulk.sock);
+	close(probe_sock);
+	close(rx_sock);
+	free(bulk.buffer);
+
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("bulk stream: %llu frames sent to %s, %.3f kbps\n", bulk.sent,
+	       tx_ifr->ifr_name,
+	       (packet_size + sizeof(struct ethhdr)) * 8 * bulk.sent / secs /
+	       1000);
+	lathist_report(&idle, "idle probe");
+	lathist_report(&loaded, "loaded probe");
+	if (idle.count && loaded.count) {
+		idle_p99 = lathist_percentile(&idle, 99);
+		if (idle_p99)
+			printf("p99 under load: %.2fx idle\n",
+			       (double)lathist_percentile(&loaded, 99) /
+			       idle_p99);
+		else
+			printf("p99 under load: n/a (idle p99 is 0)\n");
+	}
+	printf("probes lost: %u idle, %u loaded (of %u each)\n", lost_idle,
+	       lost_loaded, number_of_probes);
+	if (lost_idle || lost_loaded)
+		error("probe loss occurred\n");
+}
+
+/* Pin the calling thread to cpu and make it SCHED_FIFO */
+static void rt_thread(int cpu)
+{
+	struct sched_param param;
+	cpu_set_t set;
+	int res;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if ((res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)))
+		error("Unable to run on cpu%d: %s\n", cpu, strerror(res));
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = RT_PRIORITY;
+	if ((res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)))
+		error("Unable to set SCHED_FIFO on cpu%d: %s\n", cpu,
+		      strerror(res));
+}
+
+/*
+ * A SCHED_FIFO thread spinning on the cpu that also runs ksoftirqd only
+ * gives way through RT throttling, so refuse when that is disabled
+ */
+static void rt_shared_cpu_check(int cpu)
+{
+	FILE *fp;
+	long runtime = 0;
+
+	fprintf(stderr, "WARNING: tx and rx share cpu%d, the SCHED_FIFO busy "
+		"poll can starve\nksoftirqd and everything else on it until "
+		"RT throttling steps in\n", cpu);
+	if ((fp = fopen("/proc/sys/kernel/sched_rt_runtime_us", "r"))) {
+		if (fscanf(fp, "%ld", &runtime) != 1)
+			runtime = 0;
+		fclose(fp);
+	}
+	if (runtime < 0)
+		error("RT throttling is disabled (sched_rt_runtime_us -1), "
+		      "use -R txcpu:rxcpu with two cpus\n");
+}
+
+/*
+ * Touch the stack the probe loops will use so it is locked and mapped;
+ * the probe and control buffers of probe_phase() and probe_rx() live there
+ */
+static void prefault_stack(void)
+{
+	volatile uint8_t stack[PREFAULT_STACK];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(stack); i += 4096)
+		stack[i] = 0;
+}
+
+/* Write every page of private memory once so it is locked and mapped */
+static void prefault(void *mem, size_t size)
+{
+	volatile uint8_t *p = mem;
+	size_t i;
+
+	for (i = 0; i < size; i += 4096)
+		p[i] = p[i];
+	if (size)
+		p[size - 1] = p[size - 1];
+}
+
+static void *receiver_thread(void *arg)
+{
+	struct probe_receiver *rcv = arg;
+
+	rt_thread(rcv->cpu);
+	/* Its own stack holds the receive and control buffers */
+	prefault_stack();
+	rcv->seen = probe_rx(rcv->sock, rcv->phase, rcv->deadline, rcv->h, 1);
+	return NULL;
+}
+
+/*
+ * Floor latency of the NIC path: the same probes as -l, first from an
+ * ordinary process sleeping in poll(), then with SO_BUSY_POLL on the
+ * receive socket, SCHED_FIFO threads pinned to the tx and rx cpus and all
+ * memory locked and pre-faulted.
+ */
+static void rt_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
+		    unsigned int number_of_probes)
+{
+	struct sockaddr_ll probe_addr;
+	struct lathist normal, rt;
+	struct probe_receiver rcv;
+	pthread_t thread;
+	unsigned int lost_normal, lost_rt;
+	int probe_sock, rx_sock, busy_poll = BUSY_POLL_US, res;
+	int dma_fd, dma_latency = 0, policy;
+	struct sched_param param;
+	cpu_set_t affinity;
+
+	if (rt_cpu[1] == rt_cpu[0])
+		rt_shared_cpu_check(rt_cpu[0]);
+	probe_open(tx_ifr, rx_ifr, &probe_addr, &probe_sock, &rx_sock);
+	lathist_init(&normal);
+	lathist_init(&rt);
+
+	printf("real-time mode: tx cpu %d, rx cpu %d, SCHED_FIFO %d, "
+	       "busy poll %d us\n", rt_cpu[0], rt_cpu[1], RT_PRIORITY,
+	       BUSY_POLL_US);
+	lost_normal = probe_phase(probe_sock, &probe_addr, rx_sock, 1,
+				  number_of_probes, &normal, 0);
+
+	if (setsockopt(rx_sock, SOL_SOCKET, SO_BUSY_POLL, &busy_poll,
+		       sizeof(busy_poll)))
+		fprintf(stderr, "SO_BUSY_POLL failed: %s\n", strerror(errno));
+#ifdef SO_PREFER_BUSY_POLL
+	if (setsockopt(rx_sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &(int){ 1 },
+		       sizeof(int)))
+		fprintf(stderr, "SO_PREFER_BUSY_POLL failed: %s\n",
+			strerror(errno));
+#endif
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		fprintf(stderr, "mlockall() failed: %s\n", strerror(errno));
+	prefault_stack();
+	prefault(&rt, sizeof(rt));
+	prefault(&rcv, sizeof(rcv));
+	/* Keep the cpus out of deep C-states while the file is open */
+	if ((dma_fd = open("/dev/cpu_dma_latency", O_WRONLY)) >= 0 &&
+	    write(dma_fd, &dma_latency, sizeof(dma_latency)) < 0)
+		fprintf(stderr, "Unable to set cpu_dma_latency: %s\n",
+			strerror(errno));
+
+	/* Restored once the real-time phase is over */
+	if ((res = pthread_getschedparam(pthread_self(), &policy, &param)) ||
+	    (res = pthread_getaffinity_np(pthread_self(), sizeof(affinity),
+					  &affinity)))
+		error("Unable to get the scheduling of the main thread: %s\n",
+		      strerror(res));
+	rt_thread(rt_cpu[0]);
+	if (rt_cpu[1] == rt_cpu[0]) {
+		/* One cpu: the sender spins on the socket between probes */
+		lost_rt = probe_phase(probe_sock, &probe_addr, rx_sock, 2,
+				      number_of_probes, &rt, 1);
+	} else {
+		rcv.sock = rx_sock;
+		rcv.cpu = rt_cpu[1];
+		rcv.phase = 2;
+		rcv.h = &rt;
+		rcv.deadline = realtime_ns() + RT_SETTLE +
+			       (uint64_t)number_of_probes * PROBE_INTERVAL +
+			       PROBE_DRAIN * 1000000ULL;
+		if ((res = pthread_create(&thread, NULL, receiver_thread,
+					  &rcv)))
+			error("pthread_create() failed: %s\n", strerror(res));
+		/* Let the receiver reach its cpu before the first probe */
+		nanosleep(&(struct timespec){ 0, RT_SETTLE }, NULL);
+		probe_phase(probe_sock, &probe_addr, -1, 2, number_of_probes,
+			    &rt, 1);
+		pthread_join(thread, NULL);
+		lost_rt = number_of_probes - rcv.seen;
+	}
+	if ((res = pthread_setschedparam(pthread_self(), policy, &param)) ||
+	    (res = pthread_setaffinity_np(pthread_self(), sizeof(affinity),
+					  &affinity)))
+		error("Unable to restore the scheduling of the main thread: "
+		      "%s\n", strerror(res));
+
+	if (dma_fd >= 0)
+		close(dma_fd);
+	munlockall();
+	close(probe_sock);
+	close(rx_sock);
+
+	lathist_report(&normal, "default probe");
+	lathist_report(&rt, "real-time probe");
+	if (normal.count && rt.count)
+		printf("real-time vs default: p50 %.1f/%.1f us, "
+		       "p99 %.1f/%.1f us\n",
+		       lathist_percentile(&rt, 50) / 1e3,
+		       lathist_percentile(&normal, 50) / 1e3,
+		       lathist_percentile(&rt, 99) / 1e3,
+		       lathist_percentile(&normal, 99) / 1e3);
+	printf("probes lost: %u default, %u real-time (of %u each)\n",
+	       lost_normal, lost_rt, number_of_probes);
+	if (lost_normal || lost_rt)
+		error("probe loss occurred\n");
+}
+
+
+/*
+ * Link flap recovery: bounce ethX administratively and time how long the
+ * watched ports take to report carrier over RTNETLINK and to loop a frame
+ * again, both measured from the moment the port is set up.
+ */
+#define FLAP_HOLD_DOWN	100		/* ms the port stays down */
+#define FLAP_TIMEOUT	10000		/* ms allowed for each transition */
+#define FLAP_FRAME_GAP	1		/* ms between looped frame attempts */
+
+struct link_watch {
+	int nl;
+	int n;
+	unsigned int seq;		/* of the last RTM_GETLINK request */
+	struct ifreq *ifr[2];
+	int up[2];			/* administratively up with carrier */
+};
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Take the link state of the watched ports from RTM_NEWLINK messages.
+ * IFF_RUNNING also covers an unknown operstate, so carrier is judged by
+ * IFF_LOWER_UP, which SIOCGIFFLAGS cannot return. Returns 1 if the reply
+ * to RTM_GETLINK request seq was among them.
+ */
+static int link_parse(struct link_watch *lw, char *buffer, ssize_t len,
+		      unsigned int seq)
+{
+	struct nlmsghdr *nh;
+	struct ifinfomsg *ifi;
+	struct nlmsgerr *err;
+	int i, replied = 0;
+
+	for (nh = (struct nlmsghdr *)buffer; NLMSG_OK(nh, len);
+	     nh = NLMSG_NEXT(nh, len)) {
+		if (seq && nh->nlmsg_seq == seq) {
+			replied = 1;
+			if (nh->nlmsg_type == NLMSG_ERROR) {
+				err = NLMSG_DATA(nh);
+				if (err->error)
+					error("RTM_GETLINK failed: %s\n",
+					      strerror(-err->error));
+			}
+		}
+		if (nh->nlmsg_type != RTM_NEWLINK)
+			continue;
+		ifi = NLMSG_DATA(nh);
+		for (i = 0; i < lw->n; i++)
+			if (ifi->ifi_index == lw->ifr[i]->ifr_ifindex)
+				lw->up[i] = (ifi->ifi_flags &
+					     (IFF_UP | IFF_LOWER_UP)) ==
+					    (IFF_UP | IFF_LOWER_UP);
+	}
+	return replied;
+}
+
+/* Ask for the current state of the watched links, e.g. after lost events */
+static void link_query(struct link_watch *lw)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct ifinfomsg ifi;
+	} req;
+	struct pollfd pfd = { .fd = lw->nl, .events = POLLIN };
+	char buffer[8192];
+	ssize_t len;
+	int i;
+
+	for (i = 0; i < lw->n; i++) {
+		memset(&req, 0, sizeof(req));
+		req.nh.nlmsg_len = sizeof(req);
+		req.nh.nlmsg_type = RTM_GETLINK;
+		req.nh.nlmsg_flags = NLM_F_REQUEST;
+		req.nh.nlmsg_seq = ++lw->seq;
+		req.ifi.ifi_family = AF_UNSPEC;
+		req.ifi.ifi_index = lw->ifr[i]->ifr_ifindex;
+		if (send(lw->nl, &req, sizeof(req), 0) < 0)
+			error("netlink send() failed: %s\n", strerror(errno));
+		do {
+			if (poll(&pfd, 1, FLAP_TIMEOUT) <= 0)
+				error("No RTM_GETLINK reply for %s\n",
+				      lw->ifr[i]->ifr_name);
+			if ((len = recv(lw->nl, buffer, sizeof(buffer),
+					MSG_DONTWAIT)) < 0) {
+				/* Events were lost: ask for every link again */
+				if (errno == ENOBUFS) {
+					i = -1;
+					break;
+				}
+				if (errno != EAGAIN && errno != EINTR)
+					error("netlink recv() failed: %s\n",
+					      strerror(errno));
+				continue;
+			}
+		} while (!link_parse(lw, buffer, len, lw->seq));
+	}
+}
+
+static void link_admin(struct ifreq *dev, int up)
+{
+	struct ifreq ifr = *dev;
+
+	if (ioctl(if_sock, SIOCGIFFLAGS, &ifr))
+		error("Unable to get %s device flags: %s\n", ifr.ifr_name,
+		      strerror(errno));
+	if (up)
+		ifr.ifr_flags |= IFF_UP;
+	else
+		ifr.ifr_flags &= ~IFF_UP;
+	if (ioctl(if_sock, SIOCSIFFLAGS, &ifr))
+		error("Unable to set %s device flags: %s\n", ifr.ifr_name,
+		      strerror(errno));
+}
+
+/*
+ * Follow RTM_NEWLINK events until every watched link has carrier (up) or
+ * none has; returns the time that was seen, or 0 at the deadline.
+ */
+static uint64_t link_wait(struct link_watch *lw, int up, uint64_t deadline)
+{
+	char buffer[8192];
+	struct pollfd pfd = { .fd = lw->nl, .events = POLLIN };
+	uint64_t now;
+	ssize_t len;
+	int i, done;
+
+	for (;;) {
+		for (done = 1, i = 0; i < lw->n; i++)
+			if (lw->up[i] != up)
+				done = 0;
+		now = monotonic_ns();
+		if (done)
+			return now;
+		if (now >= deadline)
+			return 0;
+		if (poll(&pfd, 1, (deadline - now) / 1000000 + 1) <= 0)
+			continue;
+		if ((len = recv(lw->nl, buffer, sizeof(buffer),
+				MSG_DONTWAIT)) < 0) {
+			if (errno == ENOBUFS)
+				link_query(lw);
+			else if (errno != EAGAIN && errno != EINTR)
+				error("netlink recv() failed: %s\n",
+				      strerror(errno));
+			continue;
+		}
+		link_parse(lw, buffer, len, 0);
+	}
+}
+
+/* Discard everything queued on the receive socket */
+static void rx_drain(int sock, uint8_t *buffer, unsigned int packet_size)
+{
+	while (recv(sock, buffer, packet_size, MSG_DONTWAIT) >= 0)
+		;
+}
+
+/*
+ * Send a frame every FLAP_FRAME_GAP until one comes back intact; returns
+ * when it did, or 0 at the deadline. Send and receive errors such as
+ * ENETDOWN are expected while the link is still coming up.
+ */
+static uint64_t first_frame(int tx_sock, struct sockaddr_ll *addr,
+			    int rx_sock, uint8_t *tx_buffer,
+			    uint8_t *rx_buffer, unsigned int packet_size,
+			    uint64_t deadline)
+{
+	struct pollfd pfd = { .fd = rx_sock, .events = POLLIN };
+	struct sockaddr_ll from;
+	socklen_t from_len;
+	ssize_t len;
+
+	while (monotonic_ns() < deadline) {
+		if (sendto(tx_sock, tx_buffer, packet_size, 0,
+			   (struct sockaddr *)addr, sizeof(*addr)) < 0 &&
+		    errno != ENETDOWN && errno != ENOBUFS && errno != ENXIO)
+			error("sendto() failed: %s\n", strerror(errno));
+		if (poll(&pfd, 1, FLAP_FRAME_GAP) <= 0)
+			continue;
+		for (;;) {
+			from_len = sizeof(from);
+			len = recvfrom(rx_sock, rx_buffer, packet_size,
+				       MSG_DONTWAIT, (struct sockaddr *)&from,
+				       &from_len);
+			if (len < 0)
+				break;
+			if (len == (ssize_t)packet_size &&
+			    from.sll_pkttype != PACKET_OUTGOING &&
+			    !memcmp(tx_buffer, rx_buffer, packet_size))
+				return monotonic_ns();
+		}
+	}
+	return 0;
+}
+
+/*
+ * Bring back up the port flap_test() has set down, on error() and on
+ * SIGINT/SIGTERM; plain ioctls so it is safe in a signal handler.
+ */
+static void flap_restore(void)
+{
+	struct ifreq ifr;
+
+	if (!flap_down)
+		return;
+	ifr = *flap_down;
+	flap_down = NULL;
+	if (ioctl(if_sock, SIOCGIFFLAGS, &ifr) == 0) {
+		ifr.ifr_flags |= IFF_UP;
+		ioctl(if_sock, SIOCSIFFLAGS, &ifr);
+	}
+}
+
+static void flap_signal(int sig)
+{
+	flap_restore();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void flap_test(struct ifreq *tx_ifr, struct ifreq *rx_ifr,
+		      unsigned int flaps, unsigned int packet_size)
+{
+	struct sockaddr_nl nl_addr;
+	struct sockaddr_ll tx_addr, rx_addr;
+	struct timespec hold = { FLAP_HOLD_DOWN / 1000,
+				 FLAP_HOLD_DOWN % 1000 * 1000000L };
+	struct link_watch lw;
+	struct lathist carrier, frame;
+	uint8_t *tx_buffer, *rx_buffer;
+	unsigned int failed = 0, n, i;
+	uint64_t t0, t;
+	int tx_sock, rx_sock;
+
+	if (ioctl(if_sock, SIOCGIFINDEX, tx_ifr))
+		error("Unable to get %s device index: %s\n", tx_ifr->ifr_name,
+		      strerror(errno));
+	if (ioctl(if_sock, SIOCGIFINDEX, rx_ifr))
+		error("Unable to get %s device index: %s\n", rx_ifr->ifr_name,
+		      strerror(errno));
+
+	memset(&lw, 0, sizeof(lw));
+	lw.ifr[lw.n++] = tx_ifr;
+	if (rx_ifr != tx_ifr)
+		lw.ifr[lw.n++] = rx_ifr;
+	memset(&nl_addr, 0, sizeof(nl_addr));
+	nl_addr.nl_family = AF_NETLINK;
+	nl_addr.nl_groups = RTMGRP_LINK;
+	if ((lw.nl = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) < 0 ||
+	    bind(lw.nl, (struct sockaddr *)&nl_addr, sizeof(nl_addr)) < 0)
+		error("Unable to open RTNETLINK socket: %s\n",
+		      strerror(errno));
+
+	memset(&tx_addr, 0, sizeof(tx_addr));
+	tx_addr.sll_family = AF_PACKET;
+	tx_addr.sll_protocol = htons(ETH_P_802_2);
+	tx_addr.sll_ifindex = tx_ifr->ifr_ifindex;
+	tx_addr.sll_halen = ETH_ALEN;
+	memcpy(tx_addr.sll_addr, bcast, ETH_ALEN);
+
+	memset(&rx_addr, 0, sizeof(rx_addr));
+	rx_addr.sll_family = AF_PACKET;
+	rx_addr.sll_protocol = htons(ETH_P_ALL);
+	rx_addr.sll_ifindex = rx_ifr->ifr_ifindex;
+
+	if ((tx_sock = socket(PF_PACKET, SOCK_DGRAM, htons(ETH_P_802_2))) < 0 ||
+	    (rx_sock = socket(PF_PACKET, SOCK_DGRAM, htons(ETH_P_ALL))) < 0)
+		error("socket() failed\n");
+	if (bind(rx_sock, (struct sockaddr *)&rx_addr, sizeof(rx_addr)) < 0)
+		error("bind() failed\n");
+
+	if (!(tx_buffer = malloc(packet_size)) ||
+	    !(rx_buffer = malloc(packet_size)))
+		error("Out of memory\n");
+	for (i = 0; i < packet_size; i++)
+		tx_buffer[i] = test_packet[i % sizeof(test_packet)];
+
+	printf("link flap: %u bounce%s of %s, carrier watched on %s%s%s\n",
+	       flaps, flaps != 1 ? "s" : "", tx_ifr->ifr_name,
+	       tx_ifr->ifr_name, lw.n > 1 ? " and " : "",
+	       lw.n > 1 ? rx_ifr->ifr_name : "");
+	lathist_init(&carrier);
+	lathist_init(&frame);
+	link_query(&lw);
+	signal(SIGINT, flap_signal);
+	signal(SIGTERM, flap_signal);
+
+	for (n = 1; n <= flaps; n++) {
+		flap_down = tx_ifr;
+		link_admin(tx_ifr, 0);
+		if (!link_wait(&lw, 0, monotonic_ns() +
+			       FLAP_TIMEOUT * 1000000ULL))
+			printf("bounce %u: carrier did not drop\n", n);
+		nanosleep(&hold, NULL);
+		rx_drain(rx_sock, rx_buffer, packet_size);
+
+		t0 = monotonic_ns();
+		link_admin(tx_ifr, 1);
+		flap_down = NULL;
+		if (!(t = link_wait(&lw, 1, t0 + FLAP_TIMEOUT * 1000000ULL))) {
+			printf("bounce %u: no carrier within %d ms\n", n,
+			       FLAP_TIMEOUT);
+			failed++;
+			continue;
+		}
+		lathist_add(&carrier, t - t0);
+		if (!(t = first_frame(tx_sock, &tx_addr, rx_sock, tx_buffer,
+				      rx_buffer, packet_size,
+				      t0 + FLAP_TIMEOUT * 1000000ULL))) {
+			printf("bounce %u: no frame looped within %d ms\n", n,
+			       FLAP_TIMEOUT);
+			failed++;
+			continue;
+		}
+		lathist_add(&frame, t - t0);
+		if (stats) {
+			livestats_begin(stats);
+			livestats_set(&stats->tx_packets, n);
+			livestats_set(&stats->rx_packets, frame.count);
+			livestats_latency(stats, t - t0);
+			livestats_end(stats);
+		}
+	}
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	close(lw.nl);
+	close(tx_sock);
+	close(rx_sock);
+	free(tx_buffer);
+	free(rx_buffer);
+
+	lathist_report(&carrier, "time-to-carrier");
+	lathist_report(&frame, "time-to-first-frame");
+	if (failed)
+		error("link did not recover in %u of %u bounces\n", failed,
+		      flaps);
+}
+
+
 static void ifconfig(struct ifreq *ifr, int up)
 {
 
@@ -256,20 +2126,92 @@ int main(int argc, char *argv[])
 	char *if1, *if2, dummy;
 	struct timespec ts;
 	struct ifreq ifr[2], *rx_ifr = NULL;
+	int opt, live_stats = 0;
+	char desc[2 * IFNAMSIZ + 8];
+
+	while ((opt = getopt(argc, argv, "bcF:lpq:R:sUu:n:")) != -1) {
+		switch (opt) {
+		case 'b':
+			qdisc_bypass = 1;
+			break;
+		case 'c':
+			counter_report = 1;
+			break;
+		case 'F':
+			if (sscanf(optarg, "%u%c", &flaps, &dummy) != 1 ||
+			    !flaps)
+				usage();
+			break;
+		case 'l':
+			load_mode = 1;
+			break;
+		case 'p':
+			perf_counters = 1;
+			break;
+		case 'q':
+			if (sscanf(optarg, "%d%c", &probe_priority, &dummy) != 1 ||
+			    probe_priority < 0)
+				usage();
+			break;
+		case 'R':
+			if (sscanf(optarg, "%d:%d%c", &rt_cpu[0], &rt_cpu[1],
+				   &dummy) != 2) {
+				if (sscanf(optarg, "%d%c", &rt_cpu[0],
+					   &dummy) != 1)
+					usage();
+				rt_cpu[1] = rt_cpu[0];
+			}
+			if (rt_cpu[0] < 0 || rt_cpu[1] < 0 ||
+			    rt_cpu[0] >= CPU_SETSIZE || rt_cpu[1] >= CPU_SETSIZE)
+				usage();
+			rt_mode = 1;
+			break;
+		case 's':
+			live_stats = 1;
+			break;
+		case 'U':
+#ifdef HAVE_IO_URING
+			use_uring = 1;
+#else
+			fprintf(stderr, "io_uring support not compiled in\n");
+#endif
+			break;
+		case 'u':
+			if (sscanf(optarg, "%u%c", &udp_port, &dummy) != 1 ||
+			    udp_port == 0 || udp_port > 65535)
+				usage();
+			break;
+		case 'n':
+			tx_netns = optarg;
+			if ((rx_netns = strchr(optarg, ':')))
+				*(rx_netns++) = '\x0';
+			else
+				rx_netns = tx_netns;
+			if (tx_netns[0] == '\x0')
+				tx_netns = NULL;
+			if (rx_netns[0] == '\x0')
+				rx_netns = NULL;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
 
-	if (argc < 2 || argc > 4)
+	if (argc < 1 || argc > 3)
 		usage();
 
-	if (argc >= 3)
-		if (sscanf(argv[2], "%u%c", &number_of_packets, &dummy) != 1)
+	if (argc >= 2)
+		if (sscanf(argv[1], "%u%c", &number_of_packets, &dummy) != 1)
 			usage();
-	if (argc >= 4) {
-		if (sscanf(argv[3], "%u%c", &packet_size1, &dummy) != 1)
+	if (argc >= 3) {
+		if (sscanf(argv[2], "%u%c", &packet_size1, &dummy) != 1)
 			usage();
 		packet_size2 = packet_size1;
 	}
-	if1 = argv[1];
-	if ((if2 = strchr(argv[1], ':')))
+	if1 = argv[0];
+	if ((if2 = strchr(argv[0], ':')))
 		*(if2++) = '\x0';
 
 	if (if1[0] == '\x0')
@@ -287,6 +2229,35 @@ int main(int argc, char *argv[])
 		rx_ifr = &ifr[1];
 	}
 
+	if ((tx_netns || rx_netns) && !udp_port)
+		usage();
+	if ((load_mode || rt_mode || flaps) &&
+	    (udp_port || counter_report || use_uring))
+		error("-l, -R and -F cannot be combined with -u, -c or -U\n");
+	if (load_mode + rt_mode + !!flaps > 1)
+		error("-l, -R and -F are exclusive\n");
+	if (live_stats) {
+		snprintf(desc, sizeof(desc), "%s%s%s%s", udp_port ? "udp " :
+			 load_mode ? "load " : rt_mode ? "rt " :
+			 flaps ? "flap " : "",
+			 if1, if2 ? ":" : "", if2 ? if2 : "");
+		stats = livestats_open("ethtest", desc);
+	}
+	if (udp_port) {
+		if (counter_report)
+			error("-c is not supported in UDP mode\n");
+		/* Within one namespace the datagrams would go over lo */
+		if (!tx_netns || !rx_netns || !strcmp(tx_netns, rx_netns))
+			error("UDP mode needs -n txns:rxns with two different "
+			      "network namespaces\n");
+		if ((netns_self = open("/proc/self/ns/net", O_RDONLY)) < 0)
+			error("Unable to open own network namespace: %s\n",
+			      strerror(errno));
+		udp_test(&ifr[0], rx_ifr ? rx_ifr : &ifr[0],
+			 number_of_packets, packet_size1, packet_size2);
+		exit(0);
+	}
+
 	if ((if_sock = socket(PF_PACKET, SOCK_DGRAM, IPPROTO_IP)) < 0)
 		error("Error creating control socket: %s\n", strerror(errno));
 
@@ -300,8 +2271,17 @@ int main(int argc, char *argv[])
 
 	nanosleep(&ts, NULL);
 
-	eth_test(&ifr[0], rx_ifr ? rx_ifr : &ifr[0],
-		  number_of_packets, packet_size1, packet_size2);
+	if (load_mode)
+		load_test(&ifr[0], rx_ifr ? rx_ifr : &ifr[0],
+			  number_of_packets, packet_size1);
+	else if (rt_mode)
+		rt_test(&ifr[0], rx_ifr ? rx_ifr : &ifr[0], number_of_packets);
+	else if (flaps)
+		flap_test(&ifr[0], rx_ifr ? rx_ifr : &ifr[0], flaps,
+			  packet_size1);
+	else
+		eth_test(&ifr[0], rx_ifr ? rx_ifr : &ifr[0],
+			 number_of_packets, packet_size1, packet_size2);
 
 	ifconfig(&ifr[0], 0);	ifconfig(rx_ifr, 0);
 	nanosleep(&ts, NULL);
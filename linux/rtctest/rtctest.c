@@ -0,0 +1,326 @@
+/*
+ * rtctest.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * A test for the RTC operation on ATC controller. Catches each RTC second
+ * boundary with the update interrupt (RTC_UIE_ON) and compares it against
+ * CLOCK_REALTIME to measure the RTC offset and drift in ppm.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <linux/rtc.h>
+
+#define SECOND_TIMEOUT	2000	/* ms to wait for the next RTC second */
+
+struct rtc {
+	/* Block until the next RTC second starts; returns the new RTC time */
+	time_t (*wait_second)(struct rtc *rtc, struct timespec *sys);
+	void (*close)(struct rtc *rtc);
+	const char *name;
+	int fd;
+	int uie;		/* update interrupts, else poll RTC_RD_TIME */
+	/* simulated RTC: rtc = base + (mono - mono0) * (1 + ppm) + offset */
+	double sim_ppm, sim_offset;
+	struct timespec sim_mono0;
+	time_t sim_base;
+};
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "rtctest version 2.0\n"
+		"\n"
+		"Usage: rtctest [-d /dev/rtcN | -S ppm[:offset_ms]] [-w seconds]"
+		" [-o max_offset_ms] [-p max_ppm] [-r]\n"
+		"\n"
+		"  -S  use a simulated RTC drifting by ppm\n"
+		"  -r  set the OS clock to the reference date first and wait\n"
+		"      for the tod driver to update the RTC\n");
+	exit(1);
+}
+
+static double ts_diff(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+	       (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static time_t rtc_read(struct rtc *rtc)
+{
+	struct rtc_time tm;
+	struct tm t;
+
+	if (ioctl(rtc->fd, RTC_RD_TIME, &tm) < 0) {
+		fprintf(stderr, "RTC_RD_TIME failed: %s\n", strerror(errno));
+		exit(1);
+	}
+	memset(&t, 0, sizeof(t));
+	t.tm_sec = tm.tm_sec;
+	t.tm_min = tm.tm_min;
+	t.tm_hour = tm.tm_hour;
+	t.tm_mday = tm.tm_mday;
+	t.tm_mon = tm.tm_mon;
+	t.tm_year = tm.tm_year;
+	return timegm(&t);
+}
+
+static time_t dev_wait_second(struct rtc *rtc, struct timespec *sys)
+{
+	struct timespec delay = {0, 1000000};
+	struct pollfd pfd = { .fd = rtc->fd, .events = POLLIN };
+	unsigned long data;
+	time_t start, now;
+	int res, ms;
+
+	if (rtc->uie) {
+		/* A driver may accept RTC_UIE_ON and never raise it */
+		if ((res = poll(&pfd, 1, SECOND_TIMEOUT)) < 0 ||
+		    (res && read(rtc->fd, &data, sizeof(data)) < 0)) {
+			fprintf(stderr, "%s read failed: %s\n", rtc->name,
+				strerror(errno));
+			exit(1);
+		}
+		if (res) {
+			clock_gettime(CLOCK_REALTIME, sys);
+			return rtc_read(rtc);
+		}
+		fprintf(stderr, "%s: no update interrupt within %d ms, "
+			"polling\n", rtc->name, SECOND_TIMEOUT);
+		ioctl(rtc->fd, RTC_UIE_OFF, 0);
+		rtc->uie = 0;
+	}
+	/* No update interrupt: poll for the seconds register to change */
+	start = rtc_read(rtc);
+	ms = 0;
+	do {
+		if (ms++ >= SECOND_TIMEOUT) {
+			fprintf(stderr, "%s: time did not advance within "
+				"%d ms\n", rtc->name, SECOND_TIMEOUT);
+			exit(1);
+		}
+		nanosleep(&delay, NULL);
+		now = rtc_read(rtc);
+	} while (now == start);
+	clock_gettime(CLOCK_REALTIME, sys);
+	return now;
+}
+
+static void dev_close(struct rtc *rtc)
+{
+	if (rtc->uie)
+		ioctl(rtc->fd, RTC_UIE_OFF, 0);
+	close(rtc->fd);
+}
+
+static void dev_open(struct rtc *rtc, const char *name)
+{
+	rtc->name = name;
+	rtc->wait_second = dev_wait_second;
+	rtc->close = dev_close;
+	if ((rtc->fd = open(name, O_RDONLY)) < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", name,
+			strerror(errno));
+		exit(1);
+	}
+	rtc->uie = ioctl(rtc->fd, RTC_UIE_ON, 0) == 0;
+	if (!rtc->uie)
+		fprintf(stderr, "%s: no update interrupt (%s), polling\n",
+			name, strerror(errno));
+}
+
+static double sim_now(struct rtc *rtc, struct timespec *mono)
+{
+	return rtc->sim_base + rtc->sim_offset +
+	       ts_diff(&rtc->sim_mono0, mono) * (1 + rtc->sim_ppm / 1e6);
+}
+
+static time_t sim_wait_second(struct rtc *rtc, struct timespec *sys)
+{
+	struct timespec mono;
+	double next, wait;
+
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	next = floor(sim_now(rtc, &mono)) + 1;
+	wait = (next - rtc->sim_base - rtc->sim_offset) /
+	       (1 + rtc->sim_ppm / 1e6);
+	mono = rtc->sim_mono0;
+	mono.tv_sec += (time_t)wait;
+	mono.tv_nsec += (long)((wait - (time_t)wait) * 1e9);
+	if (mono.tv_nsec >= 1000000000L) {
+		mono.tv_nsec -= 1000000000L;
+		mono.tv_sec++;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &mono, NULL) ==
+	       EINTR)
+		;
+	clock_gettime(CLOCK_REALTIME, sys);
+	return (time_t)next;
+}
+
+static void sim_close(struct rtc *rtc)
+{
+	(void)rtc;
+}
+
+static void sim_open(struct rtc *rtc, double ppm, double offset_ms)
+{
+	struct timespec real;
+
+	rtc->name = "simulated RTC";
+	rtc->wait_second = sim_wait_second;
+	rtc->close = sim_close;
+	rtc->fd = -1;
+	rtc->sim_ppm = ppm;
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &rtc->sim_mono0);
+	rtc->sim_base = real.tv_sec;
+	rtc->sim_offset = real.tv_nsec / 1e9 + offset_ms / 1000;
+}
+
+/* Offset of an RTC second boundary from the system clock, in seconds */
+static double offset(time_t rtc, struct timespec *sys)
+{
+	return (rtc - sys->tv_sec) - sys->tv_nsec / 1e9;
+}
+
+/*
+ * Set the system clock to the timestamp of /etc/os-release, then wait up
+ * to 10 s for the tod driver to copy it into the RTC.
+ */
+static void set_reference(struct rtc *rtc)
+{
+	struct stat st;
+	struct timeval tv;
+	struct timespec sys;
+	time_t now;
+	int i;
+
+	if (stat("/etc/os-release", &st)) {
+		fprintf(stderr, "Unable to stat /etc/os-release: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	printf("setting OS to reference date/time\n");
+	tv.tv_sec = st.st_mtime;
+	tv.tv_usec = 0;
+	if (settimeofday(&tv, NULL)) {
+		fprintf(stderr, "settimeofday() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+	for (i = 0; i < 10; i++) {
+		now = rtc->wait_second(rtc, &sys);
+		if (fabs(offset(now, &sys)) < 1.0) {
+			printf("RTC updated after %d s\n", i + 1);
+			return;
+		}
+	}
+	printf("RTC not updated from OS date/time\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dev = "/dev/rtc0";
+	unsigned int window = 10, max_ppm = 100, max_offset_ms = 1000;
+	double sim_ppm = 0, sim_offset_ms = 0, t, o = 0;
+	double st = 0, so = 0, stt = 0, sto = 0, first = 0, slope = 0;
+	int simulate = 0, reference = 0, n, opt;
+	struct timespec sys, sys0;
+	struct rtc rtc;
+	time_t now;
+	char dummy;
+
+	while ((opt = getopt(argc, argv, "d:S:w:o:p:r")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'S':
+			simulate = 1;
+			if (sscanf(optarg, "%lf:%lf%c", &sim_ppm,
+				   &sim_offset_ms, &dummy) != 2 &&
+			    sscanf(optarg, "%lf%c", &sim_ppm, &dummy) != 1)
+				usage();
+			break;
+		case 'w':
+			if (sscanf(optarg, "%u%c", &window, &dummy) != 1 ||
+			    window < 2)
+				usage();
+			break;
+		case 'o':
+			if (sscanf(optarg, "%u%c", &max_offset_ms, &dummy) != 1)
+				usage();
+			break;
+		case 'p':
+			if (sscanf(optarg, "%u%c", &max_ppm, &dummy) != 1)
+				usage();
+			break;
+		case 'r':
+			reference = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	memset(&rtc, 0, sizeof(rtc));
+	if (simulate)
+		sim_open(&rtc, sim_ppm, sim_offset_ms);
+	else
+		dev_open(&rtc, dev);
+
+	printf("RTC test (%s)...\n", rtc.name);
+	if (reference && !simulate)
+		set_reference(&rtc);
+
+	/* Sync to a boundary, then sample one per second over the window */
+	rtc.wait_second(&rtc, &sys0);
+	printf("%6s %14s\n", "time", "offset (ms)");
+	for (n = 0; n <= (int)window; n++) {
+		now = rtc.wait_second(&rtc, &sys);
+		t = ts_diff(&sys0, &sys);
+		o = offset(now, &sys);
+		if (!n)
+			first = o;
+		printf("%6.1f %14.3f\n", t, o * 1000);
+		st += t;
+		so += o;
+		stt += t * t;
+		sto += t * o;
+	}
+	rtc.close(&rtc);
+
+	/* Least-squares slope of offset against time is the drift */
+	if (n * stt - st * st != 0)
+		slope = (n * sto - st * so) / (n * stt - st * st);
+	printf("offset: first %.3f ms, last %.3f ms\n", first * 1000, o * 1000);
+	printf("drift: %.2f ppm over %u s\n", slope * 1e6, window);
+
+	if (fabs(o) * 1000 > max_offset_ms || fabs(slope) * 1e6 > max_ppm) {
+		printf("Failed (limits %u ms, %u ppm)\n", max_offset_ms,
+		       max_ppm);
+		exit(1);
+	}
+	printf("Passed\n");
+	exit(0);
+}
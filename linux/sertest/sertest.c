@@ -27,8 +27,17 @@
 #include <poll.h>
 #include <atc_spxs.h>
 
+#include "lathist.h"
+#include "livestats.h"
+#include "perfcnt.h"
+#include "uring.h"
 
 struct termios old_termios;
+int perf_counters = 0;
+int use_uring = 0;
+int latency_report = 0;
+struct lathist latency;
+struct livestats *stats = NULL;
 
 static void usage(void) __attribute__ ((__noreturn__));
 
@@ -36,8 +45,13 @@ static void usage(void)
 {
 	fprintf(stderr, "sertest version 1.0\n"
 		"\n"
-		"Usage: sertest (port1 | port1:port2)"
-		" [port speed [number_of_packets [packet_size]]]\n");
+		"Usage: sertest [-l] [-p] [-s] [-U] (port1 | port1:port2)"
+		" [port speed [number_of_packets [packet_size]]]\n"
+		"\n"
+		"  -l  report round-trip latency percentiles\n"
+		"  -p  report performance counters for the transfer loop\n"
+		"  -s  publish live statistics under " LIVESTATS_DIR "\n"
+		"  -U  use io_uring for the transfer loop if available\n");
 	exit(1);
 }
 
@@ -114,6 +128,42 @@ int rx(int rx_fd, unsigned char *buffer, int packet_size, int timeout)
 	return 1;
 }
 
+/*
+ * Account one loop pass in the live statistics and the latency histogram:
+ * t/r say whether a packet was sent/received, start is when the pass began
+ * sending.
+ */
+static void pass_update(int tx_cnt, int rx_cnt, int t, int r,
+			int packet_size, struct timespec *start)
+{
+	struct timespec end;
+	uint64_t ns;
+
+	if (stats) {
+		livestats_begin(stats);
+		livestats_set(&stats->tx_packets, tx_cnt);
+		livestats_set(&stats->tx_bytes, (uint64_t)tx_cnt * packet_size);
+		livestats_set(&stats->rx_packets, rx_cnt);
+		livestats_set(&stats->rx_bytes, (uint64_t)rx_cnt * packet_size);
+		/* rx timed out */
+		if (!r)
+			livestats_add(&stats->errors, 1);
+		livestats_end(stats);
+	}
+	if (!t || !r)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ns = (end.tv_sec - start->tv_sec) * 1000000000ULL +
+	     end.tv_nsec - start->tv_nsec;
+	if (stats) {
+		livestats_begin(stats);
+		livestats_latency(stats, ns);
+		livestats_end(stats);
+	}
+	if (latency_report)
+		lathist_add(&latency, ns);
+}
+
 static int baud_to_constant_async(int speed)
 {
 #define B(x) case x: return B##x
@@ -189,12 +239,204 @@ const unsigned char test_packet[] = {
         0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x7e, 0x7c,
         0x61, 0x7a, 0x79, 0x20, 0x64, 0x6f, 0x67, 0x3f, 0xfe};
 
+#ifdef HAVE_IO_URING
+enum { URING_TX = 1, URING_RX, URING_TIMEOUT };
+
+/*
+ * SQE with room for nr - 1 more behind it, submitting what is queued
+ * first if the ring is full, so linked SQEs reach the kernel together
+ */
+static struct io_uring_sqe *ser_sqe(struct uring *ring, unsigned int nr)
+{
+	while (uring_sq_space(ring) < nr)
+		if (uring_submit(ring, 0) < 0) {
+			fprintf(stderr, "io_uring_enter() failed: %s\n",
+				strerror(errno));
+			exit(1);
+		}
+	return uring_get_sqe(ring);
+}
+
+static void ser_sqe_rw(struct uring *ring, int opcode, int fd,
+		       unsigned char *buf, int len, int tag,
+		       struct __kernel_timespec *timeout)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = ser_sqe(ring, 2);
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->buf_index = 0;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->user_data = tag;
+
+	sqe = ser_sqe(ring, 1);
+	sqe->opcode = IORING_OP_LINK_TIMEOUT;
+	sqe->addr = (unsigned long)timeout;
+	sqe->len = 1;
+	sqe->user_data = URING_TIMEOUT;
+}
+
+/*
+ * io_uring version of the transfer loop: the write of each packet and the
+ * read of its echo are submitted together on a registered buffer, each
+ * linked to a timeout, so one io_uring_enter() replaces the poll() and
+ * read()/write() pairs of tx() and rx(). Returns -1 before any I/O if
+ * io_uring is unavailable.
+ */
+static int ser_loop_uring(int tx_fd, int rx_fd, unsigned char *buffer,
+			  int packet_size, int number_of_packets,
+			  int *tx_cnt, int *rx_cnt, struct timeval *rx_last)
+{
+	struct uring ring;
+	struct io_uring_cqe *cqe;
+	struct iovec iov;
+	struct __kernel_timespec timeout;
+	struct timeval current;
+	/* timeout in milliseconds based on slowest baud rate (1200) */
+	int timeout_ms = (packet_size*2)*10000/1200;
+	int tx_flags, rx_flags;
+
+	if (uring_init(&ring, 8)) {
+		fprintf(stderr, "io_uring unavailable (%s), using poll()\n",
+			strerror(errno));
+		return -1;
+	}
+	iov.iov_base = buffer;
+	iov.iov_len = packet_size * 2;
+	if (uring_register_buffers(&ring, &iov, 1)) {
+		fprintf(stderr, "io_uring buffer registration failed (%s), "
+			"using poll()\n", strerror(errno));
+		uring_exit(&ring);
+		return -1;
+	}
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+
+	/* io_uring returns -EAGAIN on O_NONBLOCK files instead of waiting */
+	tx_flags = fcntl(tx_fd, F_GETFL);
+	rx_flags = fcntl(rx_fd, F_GETFL);
+	fcntl(tx_fd, F_SETFL, tx_flags & ~O_NONBLOCK);
+	fcntl(rx_fd, F_SETFL, rx_flags & ~O_NONBLOCK);
+
+	while (*tx_cnt < number_of_packets || *rx_cnt < number_of_packets) {
+		int t = 0, r = 0, tx_off = 0, rx_off = 0;
+		int tx_busy = *tx_cnt < number_of_packets, rx_busy = 1;
+		struct timespec start;
+
+		if (stats || latency_report)
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+		if (tx_busy)
+			ser_sqe_rw(&ring, IORING_OP_WRITE_FIXED, tx_fd, buffer,
+				   packet_size, URING_TX, &timeout);
+		ser_sqe_rw(&ring, IORING_OP_READ_FIXED, rx_fd,
+			   buffer + packet_size, packet_size, URING_RX,
+			   &timeout);
+
+		while (tx_busy || rx_busy) {
+			if (uring_submit(&ring, 1) < 0) {
+				fprintf(stderr, "io_uring_enter() failed: %s\n",
+					strerror(errno));
+				exit(1);
+			}
+			for (; (cqe = uring_peek_cqe(&ring));
+			     uring_cqe_seen(&ring)) {
+				int res = cqe->res;
+
+				if (cqe->user_data == URING_TIMEOUT)
+					continue;
+				if (res == -ECANCELED || res == -EINTR) {
+					/* timed out, like poll() returning 0 */
+					if (cqe->user_data == URING_TX)
+						tx_busy = 0;
+					else
+						rx_busy = 0;
+					continue;
+				}
+				if (res <= 0) {
+					fprintf(stderr, "%s() failed: %s\n",
+						cqe->user_data == URING_TX ?
+						"write" : "read",
+						res ? strerror(-res) : "EOF");
+					exit(1);
+				}
+				if (cqe->user_data == URING_TX) {
+					tx_off += res;
+					if (tx_off < packet_size)
+						ser_sqe_rw(&ring,
+							   IORING_OP_WRITE_FIXED,
+							   tx_fd, buffer + tx_off,
+							   packet_size - tx_off,
+							   URING_TX, &timeout);
+					else
+						t = 1, tx_busy = 0;
+				} else {
+					rx_off += res;
+					if (rx_off < packet_size)
+						ser_sqe_rw(&ring,
+							   IORING_OP_READ_FIXED,
+							   rx_fd, buffer +
+							   packet_size + rx_off,
+							   packet_size - rx_off,
+							   URING_RX, &timeout);
+					else
+						r = 1, rx_busy = 0;
+				}
+			}
+		}
+
+		if (r) {
+			if (gettimeofday(rx_last, NULL)) {
+				fprintf(stderr, "gettimeofday() failed: %s\n",
+					strerror(errno));
+				exit(1);
+			}
+			if (memcmp(buffer, buffer+packet_size, packet_size) != 0) {
+				fprintf(stderr, "rx packet #%d differs from tx packet %d: %2x %2x %2x %2x %2x\n",
+					*rx_cnt, *tx_cnt,
+					buffer[packet_size], buffer[packet_size+1],
+					buffer[packet_size+2], buffer[packet_size+3],
+					buffer[packet_size+4]);
+				exit(1);
+			}
+		}
+		*tx_cnt += t;
+		*rx_cnt += r;
+		if (stats || latency_report)
+			pass_update(*tx_cnt, *rx_cnt, t, r, packet_size,
+				    &start);
+
+		if (!t && !r && *tx_cnt == number_of_packets) {
+			if (gettimeofday(&current, NULL)) {
+				fprintf(stderr, "gettimeofday() failed: %s\n",
+					strerror(errno));
+				exit(1);
+			}
+			if (current.tv_sec - rx_last->tv_sec +
+			    (current.tv_usec - rx_last->tv_usec) /
+			    1000000 > 10) /* timeout 10 s */
+				break;
+		}
+	}
+
+	/* Closing the ring discards link timeouts still outstanding */
+	uring_exit(&ring);
+	fcntl(tx_fd, F_SETFL, tx_flags);
+	fcntl(rx_fd, F_SETFL, rx_flags);
+	return 0;
+}
+#endif /* HAVE_IO_URING */
+
 void ser_test(char *port1, char *port2, int port_speed, int number_of_packets, int packet_size)
 {
         unsigned char *buffer;
 	int tx_fd, rx_fd, tx_cnt = 0, rx_cnt = 0;
 	struct timespec ts;
 	struct timeval tx_first, rx_last, current;
+	struct perfcnt pc;
         int i = 0, j = 0;
 
         if ((tx_fd = open(port1, O_RDWR|O_NONBLOCK)) < 0) {
@@ -237,15 +479,32 @@ void ser_test(char *port1, char *port2, int port_speed, int number_of_packets, i
 	ts.tv_sec = 0;
 	ts.tv_nsec = 1000000;
 
+	if (latency_report)
+		lathist_init(&latency);
+	if (perf_counters) {
+		perfcnt_open(&pc);
+		perfcnt_start(&pc);
+	}
+
 	if (gettimeofday(&tx_first, NULL)) {
 		fprintf(stderr, "gettimeofday() failed: %s\n", strerror(errno));
                 exit(1);
         }
 	rx_last = tx_first;
 
+#ifdef HAVE_IO_URING
+	if (use_uring &&
+	    ser_loop_uring(tx_fd, rx_fd, buffer, packet_size, number_of_packets,
+			   &tx_cnt, &rx_cnt, &rx_last) == 0)
+		goto loop_done;
+#endif
+
 	while (tx_cnt < number_of_packets || rx_cnt < number_of_packets) {
 		int t = 0, r = 0;
+		struct timespec start;
 
+		if (stats || latency_report)
+			clock_gettime(CLOCK_MONOTONIC, &start);
 		if (tx_cnt < number_of_packets) {
                         /* timeout in milliseconds based on slowest baud rate (1200) */
 			t = tx(tx_fd, buffer, packet_size, (packet_size*2)*10000/1200);
@@ -276,6 +535,8 @@ void ser_test(char *port1, char *port2, int port_speed, int number_of_packets, i
                 }
 		tx_cnt += t;
 		rx_cnt += r;
+		if (stats || latency_report)
+			pass_update(tx_cnt, rx_cnt, t, r, packet_size, &start);
 
 		if (!t && !r) {
 			if (tx_cnt == number_of_packets) {
@@ -293,6 +554,12 @@ void ser_test(char *port1, char *port2, int port_speed, int number_of_packets, i
 		}
 	}
 
+#ifdef HAVE_IO_URING
+loop_done:
+#endif
+	if (perf_counters)
+		perfcnt_stop(&pc);
+
         if (port1[strlen(port1)-1] != 's')
                 tcsetattr(tx_fd, TCSANOW, &old_termios);
         if (strcmp(port1, port2) != 0) {
@@ -310,6 +577,13 @@ void ser_test(char *port1, char *port2, int port_speed, int number_of_packets, i
 		       packet_size * 10 * rx_cnt /
 		       ((rx_last.tv_sec - tx_first.tv_sec) * 1000.0 +
 			(rx_last.tv_usec - tx_first.tv_usec) / 1000.0));
+	if (latency_report)
+		lathist_report(&latency, "round-trip");
+	if (perf_counters) {
+		perfcnt_report(&pc, rx_cnt,
+			       (unsigned long long)rx_cnt * packet_size);
+		perfcnt_close(&pc);
+	}
         if (rx_cnt != tx_cnt) {
                 printf("packet loss occurred\n");
                 exit(1);
@@ -322,22 +596,49 @@ int main(int argc, char *argv[])
 	int number_of_packets = 1000;
 	int packet_size = 1024;
         char *port1, *port2, dummy;
-        
-	if (argc < 2 || argc > 5)
+	int opt, live_stats = 0;
+	char desc[64];
+
+	while ((opt = getopt(argc, argv, "lpsU")) != -1) {
+		switch (opt) {
+		case 'l':
+			latency_report = 1;
+			break;
+		case 'p':
+			perf_counters = 1;
+			break;
+		case 's':
+			live_stats = 1;
+			break;
+		case 'U':
+#ifdef HAVE_IO_URING
+			use_uring = 1;
+#else
+			fprintf(stderr, "io_uring support not compiled in\n");
+#endif
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1 || argc > 4)
 		usage();
 
-        if (argc >= 3)
-		if (sscanf(argv[2], "%u%c", &port_speed, &dummy) != 1)
+        if (argc >= 2)
+		if (sscanf(argv[1], "%u%c", &port_speed, &dummy) != 1)
 			usage();
-	if (argc >= 4)
-		if (sscanf(argv[3], "%u%c", &number_of_packets, &dummy) != 1)
+	if (argc >= 3)
+		if (sscanf(argv[2], "%u%c", &number_of_packets, &dummy) != 1)
 			usage();
-	if (argc >= 5)
-		if (sscanf(argv[4], "%u%c", &packet_size, &dummy) != 1)
+	if (argc >= 4)
+		if (sscanf(argv[3], "%u%c", &packet_size, &dummy) != 1)
 			usage();
 
-	port1 = argv[1];
-	if ((port2 = strchr(argv[1], ':')))
+	port1 = argv[0];
+	if ((port2 = strchr(argv[0], ':')))
 		*(port2++) = '\x0';
 
 	if (port1[0] == '\x0') {
@@ -351,6 +652,12 @@ int main(int argc, char *argv[])
                         exit(1);
                 }
         
+	if (live_stats) {
+		snprintf(desc, sizeof(desc), "%s%s%s %d", port1,
+			 port2 ? ":" : "", port2 ? port2 : "", port_speed);
+		stats = livestats_open("sertest", desc);
+	}
+
 	ser_test(port1, port2 ? port2 : port1, port_speed,
 		  number_of_packets, packet_size);
 
@@ -0,0 +1,193 @@
+/*
+ * statview.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Live viewer for the statistics ethtest and sertest publish with -s.
+ * Maps each block read-only and prints rates, errors and latency once per
+ * interval without touching the test process.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "livestats.h"
+
+#define MAX_BLOCKS	32
+
+struct view {
+	const char *path;
+	const struct livestats *ls;
+	uint64_t tx_packets, rx_packets, rx_bytes;
+	int finished;
+};
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "statview version 1.0\n"
+		"\n"
+		"Usage: statview [-i interval_ms] [-n count] [stats_file...]\n"
+		"\n"
+		"Without files, shows every " LIVESTATS_DIR "/"
+		LIVESTATS_PREFIX "* block.\n");
+	exit(1);
+}
+
+static int view_open(struct view *v, const char *path)
+{
+	const struct livestats *ls;
+	int fd;
+
+	memset(v, 0, sizeof(*v));
+	v->path = path;
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+	ls = mmap(NULL, sizeof(*ls), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ls == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+	if (__atomic_load_n(&ls->magic, __ATOMIC_ACQUIRE) != LIVESTATS_MAGIC ||
+	    ls->version != LIVESTATS_VERSION) {
+		fprintf(stderr, "%s is not a version %d stats block\n", path,
+			LIVESTATS_VERSION);
+		munmap((void *)ls, sizeof(*ls));
+		return -1;
+	}
+	v->ls = ls;
+	return 0;
+}
+
+static void view_sample(struct view *v, double secs)
+{
+	const struct livestats *ls = v->ls;
+	struct livestats c;
+	const char *state = "running";
+
+	if (livestats_read(ls, &c))
+		state = "stalled";
+	if (__atomic_load_n(&ls->done, __ATOMIC_ACQUIRE)) {
+		state = "done";
+		v->finished = 1;
+	} else if (kill(ls->pid, 0) && errno == ESRCH) {
+		state = "exited";
+		v->finished = 1;
+	}
+
+	printf("%-8s %-20.20s %10llu %10llu %10.0f %10.3f %8llu",
+	       ls->tool, ls->desc, (unsigned long long)c.tx_packets,
+	       (unsigned long long)c.rx_packets,
+	       (c.rx_packets - v->rx_packets) / secs,
+	       (c.rx_bytes - v->rx_bytes) * 8 / secs / 1e6,
+	       (unsigned long long)c.errors);
+	if (c.latency_samples)
+		printf(" %10.1f %10.1f",
+		       c.latency_sum_ns / 1e3 / c.latency_samples,
+		       c.latency_max_ns / 1e3);
+	else
+		printf(" %10s %10s", "-", "-");
+	printf(" %s\n", state);
+
+	v->tx_packets = c.tx_packets;
+	v->rx_packets = c.rx_packets;
+	v->rx_bytes = c.rx_bytes;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int interval_ms = 1000, count = 0, sample;
+	struct view views[MAX_BLOCKS];
+	struct livestats c;
+	struct timespec delay, last, now;
+	int nview = 0, running, i, opt;
+	glob_t g;
+	char dummy;
+
+	while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+		switch (opt) {
+		case 'i':
+			if (sscanf(optarg, "%u%c", &interval_ms, &dummy) != 1 ||
+			    !interval_ms)
+				usage();
+			break;
+		case 'n':
+			if (sscanf(optarg, "%u%c", &count, &dummy) != 1)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+
+	memset(&g, 0, sizeof(g));
+	if (optind == argc) {
+		if (glob(LIVESTATS_DIR "/" LIVESTATS_PREFIX "*", 0, NULL, &g)) {
+			fprintf(stderr, "No statistics found in %s\n",
+				LIVESTATS_DIR);
+			exit(1);
+		}
+		for (i = 0; i < (int)g.gl_pathc && nview < MAX_BLOCKS; i++)
+			if (view_open(&views[nview], g.gl_pathv[i]) == 0)
+				nview++;
+	} else {
+		for (i = optind; i < argc && nview < MAX_BLOCKS; i++)
+			if (view_open(&views[nview], argv[i]) == 0)
+				nview++;
+	}
+	if (!nview)
+		exit(1);
+
+	for (i = 0; i < nview; i++) {
+		livestats_read(views[i].ls, &c);
+		views[i].tx_packets = c.tx_packets;
+		views[i].rx_packets = c.rx_packets;
+		views[i].rx_bytes = c.rx_bytes;
+	}
+	delay.tv_sec = interval_ms / 1000;
+	delay.tv_nsec = (interval_ms % 1000) * 1000000L;
+	clock_gettime(CLOCK_MONOTONIC, &last);
+
+	for (sample = 0; !count || sample < count; sample++) {
+		nanosleep(&delay, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (sample % 20 == 0)
+			printf("%-8s %-20s %10s %10s %10s %10s %8s %10s %10s\n",
+			       "tool", "test", "tx", "rx", "rx pkt/s",
+			       "rx Mbit/s", "errors", "lat us", "max us");
+		running = 0;
+		for (i = 0; i < nview; i++) {
+			if (views[i].finished)
+				continue;
+			view_sample(&views[i], (now.tv_sec - last.tv_sec) +
+				    (now.tv_nsec - last.tv_nsec) / 1e9);
+			running += !views[i].finished;
+		}
+		fflush(stdout);
+		last = now;
+		if (!running)
+			break;
+	}
+
+	globfree(&g);
+	exit(0);
+}
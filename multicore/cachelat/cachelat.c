@@ -0,0 +1,430 @@
+/*
+ * cachelat.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Per-core cache hierarchy latency ladder and core-to-core cache line
+ * latency matrix. Cores that exceed the reference latency of a cache
+ * level or of a core-to-core transfer, or that are slower than their
+ * siblings by more than a threshold, fail the test.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_SIZE	64
+#define MIN_SIZE	(4 << 10)
+#define LOADS		(1 << 21)	/* dependent loads per measurement */
+#define ROUND_TRIPS	100000		/* ping-pongs per core pair */
+#define LEVELS		4		/* L1, L2, L3 and memory */
+
+struct pingpong {
+	/* -1 until pong runs on its cpu, then the ping-pong count */
+	volatile int seq __attribute__ ((aligned(LINE_SIZE)));
+	int cpu;
+};
+
+static const char *level_name[LEVELS] = { "L1", "L2", "L3", "memory" };
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "cachelat version 1.0\n"
+		"\n"
+		"Usage: cachelat [-m max_size_kb] [-t threshold_percent]"
+		" [-l l1:l2:l3:mem_ns] [-c c2c_ns]\n"
+		"\n"
+		"  -l  reference load latency limits (5:30:200:300)\n"
+		"  -c  reference core-to-core latency limit (250)\n"
+		"Runs on every CPU in the affinity mask (see taskset).\n");
+	exit(1);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set)) {
+		fprintf(stderr, "Unable to run on cpu%d: %s\n", cpu,
+			strerror(errno));
+		exit(1);
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double median(double *v, int n)
+{
+	double *tmp = malloc(n * sizeof(*tmp)), m;
+
+	if (!tmp) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memcpy(tmp, v, n * sizeof(*tmp));
+	qsort(tmp, n, sizeof(*tmp), cmp_double);
+	m = (n & 1) ? tmp[n / 2] : (tmp[n / 2 - 1] + tmp[n / 2]) / 2;
+	free(tmp);
+	return m;
+}
+
+/*
+ * Data cache sizes of cpu by level from sysfs, 0 where there is no such
+ * cache or it is not reported
+ */
+static void cache_sizes(int cpu, size_t size[LEVELS - 1])
+{
+	char path[128], type[32];
+	unsigned int level, kb;
+	FILE *fp;
+	int i, ok;
+
+	memset(size, 0, (LEVELS - 1) * sizeof(*size));
+	for (i = 0; ; i++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/"
+			 "cache/index%d/level", cpu, i);
+		if (!(fp = fopen(path, "r")))
+			break;
+		ok = fscanf(fp, "%u", &level) == 1;
+		fclose(fp);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/"
+			 "cache/index%d/type", cpu, i);
+		if (ok && (fp = fopen(path, "r"))) {
+			ok = fscanf(fp, "%31s", type) == 1 &&
+			     strcmp(type, "Instruction") != 0;
+			fclose(fp);
+		}
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/"
+			 "cache/index%d/size", cpu, i);
+		if (ok && (fp = fopen(path, "r"))) {
+			ok = fscanf(fp, "%uK", &kb) == 1;
+			fclose(fp);
+			if (ok && level >= 1 && level < LEVELS)
+				size[level - 1] = (size_t)kb << 10;
+		}
+	}
+}
+
+/*
+ * Level whose reference limit applies to a working set: the first cache
+ * at least twice its size, so sets that only partly fit are judged
+ * against the next level. Without cache information only the memory
+ * limit applies.
+ */
+static int set_level(const size_t cache[LEVELS - 1], size_t size)
+{
+	int i;
+
+	for (i = 0; i < LEVELS - 1; i++)
+		if (cache[i] && cache[i] >= 2 * size)
+			return i;
+	return LEVELS - 1;
+}
+
+/*
+ * Link every cache line of buf into one random cycle so the hardware
+ * prefetchers cannot predict the next address.
+ */
+static void build_chain(void **buf, size_t size)
+{
+	size_t lines = size / LINE_SIZE, stride = LINE_SIZE / sizeof(void *);
+	size_t *order, i, j, t;
+
+	if (!(order = malloc(lines * sizeof(*order)))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < lines; i++)
+		order[i] = i;
+	for (i = lines - 1; i > 0; i--) {
+		j = random() % (i + 1);
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+	for (i = 0; i < lines; i++)
+		buf[order[i] * stride] = &buf[order[(i + 1) % lines] * stride];
+	free(order);
+}
+
+/* Average latency of one dependent load, in nanoseconds */
+static double chase(void **buf, size_t size)
+{
+	void **p = buf;
+	double start;
+	size_t i;
+
+	for (i = 0; i < size / LINE_SIZE; i++)	/* warm up */
+		p = *p;
+	start = now_ns();
+	for (i = 0; i < LOADS; i++)
+		p = *p;
+	/* keep the chain live so the loop is not optimised away */
+	__asm__ __volatile__("" : : "r" (p));
+	return (now_ns() - start) / LOADS;
+}
+
+static void *pong(void *arg)
+{
+	struct pingpong *pp = arg;
+	int i;
+
+	pin(pp->cpu);
+	pp->seq = 0;
+	for (i = 0; i < ROUND_TRIPS; i++) {
+		while (pp->seq != 2 * i + 1)
+			;
+		pp->seq = 2 * i + 2;
+	}
+	return NULL;
+}
+
+/* One-way cache line transfer latency between two cores, in nanoseconds */
+static double ping(int cpu1, int cpu2)
+{
+	struct pingpong *pp;
+	pthread_t thread;
+	double start, ns;
+	int i;
+
+	if (posix_memalign((void **)&pp, LINE_SIZE, sizeof(*pp))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	pp->seq = -1;
+	pp->cpu = cpu2;
+	pin(cpu1);
+	if (pthread_create(&thread, NULL, pong, pp)) {
+		fprintf(stderr, "pthread_create() failed\n");
+		exit(1);
+	}
+	/* Thread creation and migration are not part of the transfers */
+	while (pp->seq != 0)
+		;
+	start = now_ns();
+	for (i = 0; i < ROUND_TRIPS; i++) {
+		pp->seq = 2 * i + 1;
+		while (pp->seq != 2 * i + 2)
+			;
+	}
+	ns = (now_ns() - start) / ROUND_TRIPS / 2;
+	pthread_join(thread, NULL);
+	free(pp);
+	return ns;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int max_kb = 64 << 10, threshold = 25;
+	unsigned int level_ns[LEVELS] = { 5, 30, 200, 300 }, c2c_ns = 250;
+	int cpus[CPU_SETSIZE], ncpu = 0, nsize = 0, i, j, k, opt, failed = 0;
+	int level;
+	size_t size, max_size, (*cache)[LEVELS - 1];
+	double *ladder, *matrix, *row, m, limit;
+	cpu_set_t set;
+	char dummy;
+	void **buf;
+
+	while ((opt = getopt(argc, argv, "m:t:l:c:")) != -1) {
+		switch (opt) {
+		case 'l':
+			if (sscanf(optarg, "%u:%u:%u:%u%c", &level_ns[0],
+				   &level_ns[1], &level_ns[2], &level_ns[3],
+				   &dummy) != 4)
+				usage();
+			break;
+		case 'c':
+			if (sscanf(optarg, "%u%c", &c2c_ns, &dummy) != 1)
+				usage();
+			break;
+		case 'm':
+			if (sscanf(optarg, "%u%c", &max_kb, &dummy) != 1 ||
+			    max_kb < MIN_SIZE >> 10)
+				usage();
+			break;
+		case 't':
+			if (sscanf(optarg, "%u%c", &threshold, &dummy) != 1)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	if (sched_getaffinity(0, sizeof(set), &set)) {
+		fprintf(stderr, "sched_getaffinity() failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &set))
+			cpus[ncpu++] = i;
+
+	max_size = (size_t)max_kb << 10;
+	for (size = MIN_SIZE; size <= max_size; size <<= 1)
+		nsize++;
+	ladder = calloc(nsize * ncpu, sizeof(*ladder));
+	matrix = calloc(ncpu * ncpu, sizeof(*matrix));
+	row = calloc(nsize > ncpu ? nsize : ncpu, sizeof(*row));
+	cache = calloc(ncpu, sizeof(*cache));
+	if (!ladder || !matrix || !row || !cache ||
+	    posix_memalign((void **)&buf, LINE_SIZE, max_size)) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	printf("Cache latency test on %d cpu%s, outlier threshold %u%%\n",
+	       ncpu, ncpu != 1 ? "s" : "", threshold);
+	printf("reference limits: L1 %u ns, L2 %u ns, L3 %u ns, memory %u ns, "
+	       "core-to-core %u ns\n", level_ns[0], level_ns[1], level_ns[2],
+	       level_ns[3], c2c_ns);
+	for (j = 0; j < ncpu; j++)
+		cache_sizes(cpus[j], cache[j]);
+
+	/* Latency ladder: ns per dependent load by working set size */
+	printf("\nload latency (ns)\n%8s", "size");
+	for (j = 0; j < ncpu; j++)
+		printf("  cpu%-4d", cpus[j]);
+	printf("\n");
+	for (i = 0, size = MIN_SIZE; i < nsize; i++, size <<= 1) {
+		build_chain(buf, size);
+		if (size >= 1 << 20)
+			printf("%7zuM", size >> 20);
+		else
+			printf("%7zuK", size >> 10);
+		for (j = 0; j < ncpu; j++) {
+			pin(cpus[j]);
+			ladder[i * ncpu + j] = chase(buf, size);
+			printf("  %7.2f", ladder[i * ncpu + j]);
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+
+	/* Core-to-core matrix: one-way cache line transfer latency */
+	if (ncpu > 1) {
+		printf("\ncore-to-core latency (ns)\n%8s", "");
+		for (j = 0; j < ncpu; j++)
+			printf("  cpu%-4d", cpus[j]);
+		printf("\n");
+		for (i = 0; i < ncpu; i++) {
+			printf("  cpu%-4d", cpus[i]);
+			for (j = 0; j < ncpu; j++) {
+				if (i != j)
+					matrix[i * ncpu + j] =
+						ping(cpus[i], cpus[j]);
+				if (i == j)
+					printf("  %7s", "-");
+				else
+					printf("  %7.1f", matrix[i * ncpu + j]);
+				fflush(stdout);
+			}
+			printf("\n");
+		}
+	}
+	printf("\n");
+
+	/* A core fails if it exceeds the reference limit of a level ... */
+	for (i = 0, size = MIN_SIZE; i < nsize; i++, size <<= 1) {
+		for (j = 0; j < ncpu; j++) {
+			level = set_level(cache[j], size);
+			if (ladder[i * ncpu + j] <= level_ns[level])
+				continue;
+			printf("cpu%d: %zuK load latency %.2f ns, %s limit "
+			       "%u ns\n", cpus[j], size >> 10,
+			       ladder[i * ncpu + j], level_name[level],
+			       level_ns[level]);
+			failed = 1;
+		}
+	}
+	for (i = 0; i < ncpu; i++)
+		for (j = 0; j < ncpu; j++) {
+			if (i == j || matrix[i * ncpu + j] <= c2c_ns)
+				continue;
+			printf("cpu%d -> cpu%d: core-to-core latency %.1f ns, "
+			       "limit %u ns\n", cpus[i], cpus[j],
+			       matrix[i * ncpu + j], c2c_ns);
+			failed = 1;
+		}
+
+	/* ... or if it is slower than the median core by > threshold */
+	for (i = 0, size = MIN_SIZE; i < nsize && ncpu > 2; i++, size <<= 1) {
+		m = median(&ladder[i * ncpu], ncpu);
+		limit = m * (100 + threshold) / 100;
+		for (j = 0; j < ncpu; j++) {
+			if (ladder[i * ncpu + j] <= limit)
+				continue;
+			printf("cpu%d: %zuK load latency %.2f ns, median %.2f ns\n",
+			       cpus[j], size >> 10, ladder[i * ncpu + j], m);
+			failed = 1;
+		}
+	}
+	if (ncpu > 2) {
+		double *core = calloc(ncpu, sizeof(*core));
+
+		if (!core) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		for (i = 0; i < ncpu; i++) {
+			for (j = 0, k = 0; j < ncpu; j++)
+				if (i != j)
+					row[k++] = matrix[i * ncpu + j];
+			core[i] = median(row, k);
+		}
+		m = median(core, ncpu);
+		limit = m * (100 + threshold) / 100;
+		for (i = 0; i < ncpu; i++) {
+			if (core[i] <= limit)
+				continue;
+			printf("cpu%d: core-to-core latency %.1f ns, "
+			       "median %.1f ns\n", cpus[i], core[i], m);
+			failed = 1;
+		}
+		free(core);
+	} else {
+		printf("Fewer than 3 cpus, reference limits only\n");
+	}
+
+	free(buf);
+	free(ladder);
+	free(matrix);
+	free(row);
+	free(cache);
+	if (failed) {
+		printf("Failed\n");
+		exit(1);
+	}
+	printf("Passed\n");
+	exit(0);
+}
@@ -0,0 +1,324 @@
+/*
+ * rtlatency.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Real-time wakeup latency test. A SCHED_FIFO thread on every CPU sleeps
+ * on an absolute CLOCK_MONOTONIC deadline and records how late it woke,
+ * optionally while memtester-style memory load runs on the same CPUs.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define HIST_US		10000	/* histogram range, 1 us buckets */
+
+struct timer_thread {
+	int cpu;
+	uint32_t hist[HIST_US + 1];	/* last bucket counts overflows */
+	unsigned long samples;
+	long min_ns, max_ns;
+	double sum_ns;
+	pthread_t thread;
+};
+
+struct load_thread {
+	int cpu;
+	size_t size;
+	pthread_t thread;
+};
+
+static volatile sig_atomic_t stop = 0;
+static unsigned int interval_us = 1000;
+static int priority = 95;
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "rtlatency version 1.0\n"
+		"\n"
+		"Usage: rtlatency [-d duration_s] [-i interval_us]"
+		" [-p priority] [-m load_mb] [-x max_latency_us] [-H]\n"
+		"\n"
+		"  -m  run a memory load thread of load_mb per cpu\n"
+		"  -H  print the latency histograms\n"
+		"Runs on every CPU in the affinity mask (see taskset).\n");
+	exit(1);
+}
+
+static void sigint(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+		fprintf(stderr, "Unable to run on cpu%d\n", cpu);
+		exit(1);
+	}
+}
+
+static void *timer(void *arg)
+{
+	struct timer_thread *t = arg;
+	struct sched_param param;
+	struct timespec next, now;
+	long ns;
+	int err;
+
+	pin(t->cpu);
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))) {
+		fprintf(stderr, "Unable to set SCHED_FIFO on cpu%d: %s\n",
+			t->cpu, strerror(err));
+		exit(1);
+	}
+
+	t->min_ns = HIST_US * 1000L;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop) {
+		next.tv_nsec += interval_us * 1000L;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		if ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					   &next, NULL))) {
+			if (err == EINTR)
+				continue;
+			fprintf(stderr, "clock_nanosleep() failed: %s\n",
+				strerror(err));
+			exit(1);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ns = (now.tv_sec - next.tv_sec) * 1000000000L +
+		     (now.tv_nsec - next.tv_nsec);
+		if (ns < t->min_ns)
+			t->min_ns = ns;
+		if (ns > t->max_ns)
+			t->max_ns = ns;
+		t->sum_ns += ns;
+		t->hist[ns / 1000 < HIST_US ? ns / 1000 : HIST_US]++;
+		t->samples++;
+	}
+	return NULL;
+}
+
+/* memtester-style load: stream writes and read-back over a large buffer */
+static void *load(void *arg)
+{
+	struct load_thread *l = arg;
+	size_t n = l->size / sizeof(unsigned long), i;
+	unsigned long *buf, pattern = 0;
+
+	pin(l->cpu);
+	if (!(buf = malloc(l->size))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	while (!stop) {
+		pattern = ~pattern;
+		for (i = 0; i < n && !stop; i++)
+			buf[i] = pattern ^ i;
+		for (i = 0; i < n && !stop; i++)
+			if (buf[i] != (pattern ^ i)) {
+				fprintf(stderr, "cpu%d: memory mismatch at "
+					"offset %zu\n", l->cpu, i);
+				exit(1);
+			}
+	}
+	free(buf);
+	return NULL;
+}
+
+/* Latency in us below which the given fraction of samples fall */
+static unsigned int percentile(struct timer_thread *t, double fraction)
+{
+	unsigned long target = t->samples * fraction, count = 0;
+	unsigned int us;
+
+	for (us = 0; us < HIST_US; us++) {
+		count += t->hist[us];
+		if (count > target)
+			break;
+	}
+	return us;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int duration = 60, load_mb = 0, max_us = 1000;
+	int ncpu = 0, show_hist = 0, failed = 0, dma_fd, i, opt;
+	int32_t dma_latency = 0;
+	struct timer_thread *timers;
+	struct load_thread *loads = NULL;
+	struct timespec end;
+	cpu_set_t set;
+	char dummy;
+	unsigned int us;
+
+	while ((opt = getopt(argc, argv, "d:i:p:m:x:H")) != -1) {
+		switch (opt) {
+		case 'd':
+			if (sscanf(optarg, "%u%c", &duration, &dummy) != 1)
+				usage();
+			break;
+		case 'i':
+			if (sscanf(optarg, "%u%c", &interval_us, &dummy) != 1 ||
+			    !interval_us)
+				usage();
+			break;
+		case 'p':
+			if (sscanf(optarg, "%d%c", &priority, &dummy) != 1 ||
+			    priority < 1 || priority > 99)
+				usage();
+			break;
+		case 'm':
+			if (sscanf(optarg, "%u%c", &load_mb, &dummy) != 1)
+				usage();
+			break;
+		case 'x':
+			if (sscanf(optarg, "%u%c", &max_us, &dummy) != 1)
+				usage();
+			break;
+		case 'H':
+			show_hist = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	if (sched_getaffinity(0, sizeof(set), &set)) {
+		fprintf(stderr, "sched_getaffinity() failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	timers = calloc(CPU_COUNT(&set), sizeof(*timers));
+	if (load_mb)
+		loads = calloc(CPU_COUNT(&set), sizeof(*loads));
+	if (!timers || (load_mb && !loads)) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &set))
+			timers[ncpu++].cpu = i;
+
+	/* No page faults or deep C-states while measuring */
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		fprintf(stderr, "mlockall() failed: %s\n", strerror(errno));
+	if ((dma_fd = open("/dev/cpu_dma_latency", O_WRONLY)) >= 0 &&
+	    write(dma_fd, &dma_latency, sizeof(dma_latency)) < 0)
+		fprintf(stderr, "Unable to set cpu_dma_latency: %s\n",
+			strerror(errno));
+
+	signal(SIGINT, sigint);
+	signal(SIGTERM, sigint);
+
+	printf("RT latency test on %d cpu%s, %u s, interval %u us, "
+	       "priority %d, load %u MB/cpu\n", ncpu, ncpu != 1 ? "s" : "",
+	       duration, interval_us, priority, load_mb);
+
+	for (i = 0; i < ncpu && load_mb; i++) {
+		loads[i].cpu = timers[i].cpu;
+		loads[i].size = (size_t)load_mb << 20;
+		if (pthread_create(&loads[i].thread, NULL, load, &loads[i])) {
+			fprintf(stderr, "pthread_create() failed\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < ncpu; i++)
+		if (pthread_create(&timers[i].thread, NULL, timer, &timers[i])) {
+			fprintf(stderr, "pthread_create() failed\n");
+			exit(1);
+		}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += duration;
+	while (!stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &end,
+					NULL) == EINTR)
+		;
+	stop = 1;
+	for (i = 0; i < ncpu; i++)
+		pthread_join(timers[i].thread, NULL);
+	for (i = 0; i < ncpu && load_mb; i++)
+		pthread_join(loads[i].thread, NULL);
+	if (dma_fd >= 0)
+		close(dma_fd);
+
+	printf("%6s %10s %8s %8s %8s %8s %8s\n", "cpu", "samples", "min us",
+	       "avg us", "p99 us", "p99.99us", "max us");
+	for (i = 0; i < ncpu; i++) {
+		struct timer_thread *t = &timers[i];
+
+		if (!t->samples) {
+			printf("%6d %10s\n", t->cpu, "none");
+			failed = 1;
+			continue;
+		}
+		printf("%6d %10lu %8.1f %8.1f %8u %8u %8.1f%s\n", t->cpu,
+		       t->samples, t->min_ns / 1000.0,
+		       t->sum_ns / t->samples / 1000.0, percentile(t, 0.99),
+		       percentile(t, 0.9999), t->max_ns / 1000.0,
+		       t->hist[HIST_US] ? " (overflow)" : "");
+		if (t->max_ns > max_us * 1000L) {
+			printf("cpu%d: max latency %.1f us exceeds %u us\n",
+			       t->cpu, t->max_ns / 1000.0, max_us);
+			failed = 1;
+		}
+	}
+	if (show_hist) {
+		printf("\n%6s", "us");
+		for (i = 0; i < ncpu; i++)
+			printf(" %9s%-3d", "cpu", timers[i].cpu);
+		printf("\n");
+		for (us = 0; us <= HIST_US; us++) {
+			int used = 0;
+
+			for (i = 0; i < ncpu; i++)
+				used |= timers[i].hist[us] != 0;
+			if (!used)
+				continue;
+			printf(us < HIST_US ? "%6u" : "%5u+", us);
+			for (i = 0; i < ncpu; i++)
+				printf(" %12u", timers[i].hist[us]);
+			printf("\n");
+		}
+	}
+
+	free(timers);
+	free(loads);
+	if (failed) {
+		printf("Failed\n");
+		exit(1);
+	}
+	printf("Passed\n");
+	exit(0);
+}
@@ -0,0 +1,343 @@
+/*
+ * thermstress.c
+ *
+ * Copyright (C) 2026 Intelight Inc.
+ *
+ * Multicore burn-in stress with frequency and thermal telemetry. Runs a
+ * vectorised floating point workload pinned to every CPU while sampling
+ * scaling_cur_freq, the thermal zones and the work rate of each core, and
+ * fails if any core cannot sustain its initial throughput.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_SIZE	64
+#define VEC_LEN		256	/* 3 x 4K arrays stay in L1 */
+#define VEC_PASSES	64	/* passes per unit of work */
+#define MAX_ZONES	16
+#define BASELINE	3	/* samples averaged for the initial rate */
+
+typedef float v4sf __attribute__ ((vector_size(16)));
+
+struct worker {
+	int cpu;
+	unsigned long work;
+	unsigned long last_work;
+	double baseline, sustained;
+	unsigned int min_khz, max_khz;
+	char governor[32];
+	pthread_t thread;
+} __attribute__ ((aligned(LINE_SIZE)));
+
+static volatile sig_atomic_t stop = 0;
+
+static void usage(void) __attribute__ ((__noreturn__));
+
+static void usage(void)
+{
+	fprintf(stderr, "thermstress version 1.0\n"
+		"\n"
+		"Usage: thermstress [-d duration_s] [-i interval_s]"
+		" [-t threshold_percent] [-k]\n"
+		"\n"
+		"  -k  keep the current cpufreq governor\n"
+		"Runs on every CPU in the affinity mask (see taskset).\n");
+	exit(1);
+}
+
+static void sigint(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static int read_sysfs(const char *path, char *buf, int len)
+{
+	FILE *fp;
+
+	if (!(fp = fopen(path, "r")))
+		return -1;
+	if (!fgets(buf, len, fp)) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+static void write_sysfs(const char *path, const char *value)
+{
+	FILE *fp;
+
+	if (!(fp = fopen(path, "w")) || fputs(value, fp) < 0 || fclose(fp))
+		fprintf(stderr, "Unable to write %s: %s\n", path,
+			strerror(errno));
+}
+
+static unsigned int cur_khz(int cpu)
+{
+	char path[128], buf[32];
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+	if (read_sysfs(path, buf, sizeof(buf)))
+		return 0;
+	return strtoul(buf, NULL, 10);
+}
+
+static void *stress(void *arg)
+{
+	struct worker *w = arg;
+	v4sf a[VEC_LEN], b[VEC_LEN], c[VEC_LEN];
+	cpu_set_t set;
+	int i, k;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set)) {
+		fprintf(stderr, "Unable to run on cpu%d: %s\n", w->cpu,
+			strerror(errno));
+		exit(1);
+	}
+	/* c converges to 1.0, so no overflow or denormal slow paths */
+	for (i = 0; i < VEC_LEN; i++) {
+		a[i] = (v4sf){ 0.999f, 0.998f, 0.997f, 0.996f };
+		b[i] = 1.0f - a[i];
+		c[i] = (v4sf){ 0.0f, 0.0f, 0.0f, 0.0f };
+	}
+	while (!stop) {
+		for (k = 0; k < VEC_PASSES; k++)
+			for (i = 0; i < VEC_LEN; i++)
+				c[i] = c[i] * a[i] + b[i];
+		__asm__ __volatile__("" : : "r" (c) : "memory");
+		__atomic_store_n(&w->work, w->work + 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int duration = 300, interval = 1, threshold = 10;
+	int keep_governor = 0, ncpu = 0, nzone = 0, nsample, i, j, opt;
+	int failed = 0;
+	struct worker *workers;
+	struct timespec next, now, last;
+	double *rates, dt, mflop, m;
+	char path[128], buf[32], dummy;
+	cpu_set_t set;
+
+	while ((opt = getopt(argc, argv, "d:i:t:k")) != -1) {
+		switch (opt) {
+		case 'd':
+			if (sscanf(optarg, "%u%c", &duration, &dummy) != 1)
+				usage();
+			break;
+		case 'i':
+			if (sscanf(optarg, "%u%c", &interval, &dummy) != 1 ||
+			    !interval)
+				usage();
+			break;
+		case 't':
+			if (sscanf(optarg, "%u%c", &threshold, &dummy) != 1 ||
+			    threshold > 100)
+				usage();
+			break;
+		case 'k':
+			keep_governor = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+	nsample = duration / interval;
+	if (nsample < 2 * BASELINE) {
+		fprintf(stderr, "Duration must cover at least %d intervals\n",
+			2 * BASELINE);
+		exit(1);
+	}
+
+	if (sched_getaffinity(0, sizeof(set), &set)) {
+		fprintf(stderr, "sched_getaffinity() failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	if (posix_memalign((void **)&workers, LINE_SIZE,
+			   CPU_COUNT(&set) * sizeof(*workers)) ||
+	    !(rates = calloc(nsample * CPU_COUNT(&set), sizeof(*rates)))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (!CPU_ISSET(i, &set))
+			continue;
+		memset(&workers[ncpu], 0, sizeof(workers[ncpu]));
+		workers[ncpu].cpu = i;
+		workers[ncpu].min_khz = ~0U;
+		ncpu++;
+	}
+	for (nzone = 0; nzone < MAX_ZONES; nzone++) {
+		snprintf(path, sizeof(path),
+			 "/sys/class/thermal/thermal_zone%d/temp", nzone);
+		if (access(path, R_OK))
+			break;
+	}
+
+	/* Run every core flat out, restoring the governors afterwards */
+	for (i = 0; i < ncpu && !keep_governor; i++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+			 workers[i].cpu);
+		if (read_sysfs(path, workers[i].governor,
+			       sizeof(workers[i].governor)) == 0)
+			write_sysfs(path, "performance");
+	}
+
+	signal(SIGINT, sigint);
+	signal(SIGTERM, sigint);
+
+	printf("Thermal stress test on %d cpu%s, %u s, threshold %u%%\n",
+	       ncpu, ncpu != 1 ? "s" : "", duration, threshold);
+	printf("%6s", "time");
+	for (i = 0; i < ncpu; i++)
+		printf(" %6s%-3d %8s%-3d", "MHz", workers[i].cpu,
+		       "MFLOPS", workers[i].cpu);
+	for (j = 0; j < nzone; j++)
+		printf("  tz%-3d", j);
+	printf("\n");
+
+	for (i = 0; i < ncpu; i++)
+		if (pthread_create(&workers[i].thread, NULL, stress,
+				   &workers[i])) {
+			fprintf(stderr, "pthread_create() failed\n");
+			exit(1);
+		}
+
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	next = last;
+	for (j = 0; j < nsample && !stop; j++) {
+		next.tv_sec += interval;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				       NULL) == EINTR && !stop)
+			;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		dt = (now.tv_sec - last.tv_sec) +
+		     (now.tv_nsec - last.tv_nsec) / 1e9;
+		last = now;
+
+		printf("%6u", (j + 1) * interval);
+		for (i = 0; i < ncpu; i++) {
+			struct worker *w = &workers[i];
+			unsigned long work = __atomic_load_n(&w->work,
+							     __ATOMIC_RELAXED);
+			unsigned int khz = cur_khz(w->cpu);
+
+			/* 2 flops x 4 lanes per element */
+			mflop = (double)(work - w->last_work) *
+				VEC_PASSES * VEC_LEN * 8 / 1e6;
+			w->last_work = work;
+			rates[j * ncpu + i] = mflop / dt;
+			if (khz && khz < w->min_khz)
+				w->min_khz = khz;
+			if (khz > w->max_khz)
+				w->max_khz = khz;
+			printf(" %9u %11.1f", khz / 1000, mflop / dt);
+		}
+		for (i = 0; i < nzone; i++) {
+			snprintf(path, sizeof(path),
+				 "/sys/class/thermal/thermal_zone%d/temp", i);
+			if (read_sysfs(path, buf, sizeof(buf)))
+				printf("  %5s", "?");
+			else
+				printf("  %5.1f", strtol(buf, NULL, 10) / 1000.0);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	nsample = j;
+
+	stop = 1;
+	for (i = 0; i < ncpu; i++)
+		pthread_join(workers[i].thread, NULL);
+	for (i = 0; i < ncpu && !keep_governor; i++) {
+		if (!workers[i].governor[0])
+			continue;
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+			 workers[i].cpu);
+		write_sysfs(path, workers[i].governor);
+	}
+
+	if (nsample < 2 * BASELINE) {
+		printf("Stopped before enough samples were taken\nFailed\n");
+		exit(1);
+	}
+
+	/*
+	 * Baseline is the mean of the first samples, sustained the mean of
+	 * the last quarter of the run.
+	 */
+	printf("\n%6s %10s %10s %8s %8s\n", "cpu", "baseline", "sustained",
+	       "min MHz", "max MHz");
+	for (i = 0; i < ncpu; i++) {
+		struct worker *w = &workers[i];
+		int first = nsample - nsample / 4;
+
+		for (j = 0; j < BASELINE; j++)
+			w->baseline += rates[j * ncpu + i] / BASELINE;
+		for (j = first; j < nsample; j++)
+			w->sustained += rates[j * ncpu + i] / (nsample - first);
+		printf("%6d %10.1f %10.1f %8u %8u\n", w->cpu, w->baseline,
+		       w->sustained, w->min_khz == ~0U ? 0 : w->min_khz / 1000,
+		       w->max_khz / 1000);
+		if (w->sustained < w->baseline * (100 - threshold) / 100) {
+			printf("cpu%d: throughput dropped %.1f%% during the run\n",
+			       w->cpu, 100 * (1 - w->sustained / w->baseline));
+			failed = 1;
+		}
+	}
+	/* ...and every core must keep up with the median core */
+	for (i = 0; i < ncpu; i++)
+		rates[i] = workers[i].sustained;
+	for (i = 0; i < ncpu; i++)
+		for (j = i + 1; j < ncpu; j++)
+			if (rates[j] < rates[i]) {
+				m = rates[i];
+				rates[i] = rates[j];
+				rates[j] = m;
+			}
+	m = (ncpu & 1) ? rates[ncpu / 2] :
+			 (rates[ncpu / 2 - 1] + rates[ncpu / 2]) / 2;
+	for (i = 0; i < ncpu; i++) {
+		if (workers[i].sustained >= m * (100 - threshold) / 100)
+			continue;
+		printf("cpu%d: sustained %.1f MFLOPS, median core %.1f\n",
+		       workers[i].cpu, workers[i].sustained, m);
+		failed = 1;
+	}
+
+	free(workers);
+	free(rates);
+	if (failed) {
+		printf("Failed\n");
+		exit(1);
+	}
+	printf("Passed\n");
+	exit(0);
+}